@@ -0,0 +1,216 @@
+#include "benchmark_app.hpp"
+#include "engine_utils.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine {
+
+	// Seconds of recorded scene time between saved keys
+	static constexpr float RECORD_KEY_INTERVAL = 0.25f;
+	static constexpr float OBJECT_SPACING = 1.5f;
+
+	BenchmarkApp::BenchmarkApp(const BenchmarkSettings& benchmarkSettings)
+		: FirstApp(benchmarkSettings.app),
+		benchmarkSettings{ benchmarkSettings },
+		rngState{ benchmarkSettings.seed != 0 ? benchmarkSettings.seed : 1u } {
+		if (!benchmarkSettings.recordPathFile.empty() && benchmarkSettings.app.headless) {
+			throw std::runtime_error("Recording a camera path needs a window");
+		}
+		if (!benchmarkSettings.recordPathFile.empty() && !benchmarkSettings.cameraPathFile.empty()) {
+			throw std::runtime_error("A camera path can't be followed and recorded at once");
+		}
+		if (benchmarkSettings.models.empty() && benchmarkSettings.objectCount > 0) {
+			throw std::runtime_error("Benchmark scene has objects but no models");
+		}
+
+		// Recording starts from an empty path, its keys are timed from the start of the recording
+		if (!benchmarkSettings.recordPathFile.empty()) {
+			return;
+		}
+		if (!benchmarkSettings.cameraPathFile.empty()) {
+			cameraPath = CameraPath::LoadFromFile(benchmarkSettings.cameraPathFile);
+		}
+		else {
+			// Far enough out to see the whole grid, above it and looking down
+			float gridSide = std::ceil(std::sqrt(static_cast<float>(benchmarkSettings.objectCount))) * OBJECT_SPACING;
+			float duration = benchmarkSettings.app.frameCount * benchmarkSettings.app.fixedTimeStep;
+			cameraPath = CameraPath::Orbit(gridSide * 0.75f + 3.0f, -gridSide * 0.25f - 1.5f, std::max(duration, 1.0f));
+		}
+	}
+
+	void BenchmarkApp::RunBenchmark() {
+		run();
+
+		if (!benchmarkSettings.recordPathFile.empty()) {
+			cameraPath.SaveToFile(benchmarkSettings.recordPathFile);
+			std::cout << "Recorded camera path to " << benchmarkSettings.recordPathFile << std::endl;
+			return;
+		}
+
+		if (benchmarkSettings.outputFile.empty()) {
+			writeReport(std::cout);
+			return;
+		}
+		std::ofstream file{ benchmarkSettings.outputFile };
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to write benchmark report: " + benchmarkSettings.outputFile);
+		}
+		writeReport(file);
+	}
+
+	float BenchmarkApp::random01() {
+		// xorshift32
+		rngState ^= rngState << 13;
+		rngState ^= rngState >> 17;
+		rngState ^= rngState << 5;
+		return (rngState >> 8) / 16777216.0f;
+	}
+
+	void BenchmarkApp::loadGameObjects() {
+		// Each model is loaded once and shared by its objects
+		std::vector<std::shared_ptr<EngineModel>> models;
+		for (auto& modelFile : benchmarkSettings.models) {
+			models.push_back(EngineModel::CreateModelFromFile(engineDevice, modelFile));
+		}
+
+		// Objects on a square grid centred on the origin, with random scale and heading
+		uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(benchmarkSettings.objectCount))));
+		float gridOffset = (gridSize - 1) * OBJECT_SPACING * 0.5f;
+		for (uint32_t i = 0; i < benchmarkSettings.objectCount; i++) {
+			auto object = EngineGameObject::CreateGameObject();
+			object.model = models[i % models.size()];
+			object.transform.translation = {
+				(i % gridSize) * OBJECT_SPACING - gridOffset,
+				0.5f,
+				(i / gridSize) * OBJECT_SPACING - gridOffset };
+			float scale = 1.5f + random01() * 1.5f;
+			object.transform.scale = glm::vec3(scale, scale * 0.5f, scale);
+			object.transform.rotation.y = random01() * glm::two_pi<float>();
+			gameObjects.emplace(object.GetId(), std::move(object));
+		}
+
+		// Lights scattered over the grid just above the objects
+		float lightArea = std::max(gridOffset, 1.0f);
+		for (uint32_t i = 0; i < benchmarkSettings.lightCount; i++) {
+			glm::vec3 color{ 0.2f + random01() * 0.8f, 0.2f + random01() * 0.8f, 0.2f + random01() * 0.8f };
+			auto pointLight = EngineGameObject::CreatePointLight(.2f, 0.1f, color);
+			pointLight.transform.translation = {
+				(random01() * 2.0f - 1.0f) * lightArea,
+				-0.5f - random01(),
+				(random01() * 2.0f - 1.0f) * lightArea };
+			gameObjects.emplace(pointLight.GetId(), std::move(pointLight));
+		}
+	}
+
+	void BenchmarkApp::updateCamera(float frameTime, EngineGameObject& viewerObject) {
+		if (!benchmarkSettings.recordPathFile.empty()) {
+			FirstApp::updateCamera(frameTime, viewerObject);
+			if (cameraPath.IsEmpty() || recordedTime - lastKeyTime >= RECORD_KEY_INTERVAL) {
+				cameraPath.AddKey({ recordedTime, viewerObject.transform.translation, viewerObject.transform.rotation });
+				lastKeyTime = recordedTime;
+			}
+			recordedTime += frameTime;
+			return;
+		}
+
+		cameraPath.Sample(sceneTime, viewerObject.transform);
+		sceneTime += frameTime;
+	}
+
+	void BenchmarkApp::onFrameComplete(const FrameTimings& timings) {
+		if (timings.frameNumber > benchmarkSettings.warmupFrames) {
+			cpuSamples["frame"].push_back(timings.frameMs);
+			cpuSamples["beginFrame"].push_back(timings.beginFrameMs);
+			cpuSamples["frameSetup"].push_back(timings.frameSetupMs);
+			cpuSamples["lightUpdate"].push_back(timings.lightUpdateMs);
+			cpuSamples["objectUpdate"].push_back(timings.objectUpdateMs);
+			cpuSamples["geometry"].push_back(timings.geometryMs);
+			cpuSamples["drawQueueFlush"].push_back(timings.drawQueueFlushMs);
+			if (settings.deferredShading)
+				cpuSamples["deferredLighting"].push_back(timings.deferredLightingMs);
+			cpuSamples["pointLightRender"].push_back(timings.pointLightRenderMs);
+			cpuSamples["endFrame"].push_back(timings.endFrameMs);
+		}
+
+		// GPU results trail the frame, filtered by the frame they were recorded in
+		if (timings.gpuFrameNumber > benchmarkSettings.warmupFrames) {
+			for (auto& zone : timings.gpuZones) {
+				gpuSamples[zone.name].push_back(zone.milliseconds);
+			}
+		}
+	}
+
+	BenchmarkApp::Summary BenchmarkApp::summarize(std::vector<double> samples) {
+		if (samples.empty())
+			return {};
+
+		// Nearest rank
+		std::sort(samples.begin(), samples.end());
+		auto percentile = [&](double p) {
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+			return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+		};
+		double sum = 0.0;
+		for (double sample : samples)
+			sum += sample;
+
+		return { sum / samples.size(), samples.front(), percentile(50), percentile(90), percentile(95),
+			percentile(99), samples.back() };
+	}
+
+	void BenchmarkApp::writeReport(std::ostream& out) {
+		auto writeSummaries = [&](const std::map<std::string, std::vector<double>>& samples) {
+			out << "{";
+			const char* separator = "\n";
+			for (auto& keyVal : samples) {
+				Summary summary = summarize(keyVal.second);
+				out << separator << "    " << JsonString(keyVal.first) << ": { "
+					<< "\"samples\": " << keyVal.second.size()
+					<< ", \"mean\": " << summary.mean
+					<< ", \"min\": " << summary.min
+					<< ", \"p50\": " << summary.p50
+					<< ", \"p90\": " << summary.p90
+					<< ", \"p95\": " << summary.p95
+					<< ", \"p99\": " << summary.p99
+					<< ", \"max\": " << summary.max << " }";
+				separator = ",\n";
+			}
+			out << "\n  }";
+		};
+
+		auto& app = benchmarkSettings.app;
+		out << "{\n";
+		out << "  \"device\": " << JsonString(engineDevice.properties.deviceName) << ",\n";
+		out << "  \"config\": {\n";
+		out << "    \"frames\": " << app.frameCount << ",\n";
+		out << "    \"warmupFrames\": " << benchmarkSettings.warmupFrames << ",\n";
+		out << "    \"fixedTimeStep\": " << app.fixedTimeStep << ",\n";
+		out << "    \"width\": " << app.extent.width << ",\n";
+		out << "    \"height\": " << app.extent.height << ",\n";
+		out << "    \"headless\": " << (app.headless ? "true" : "false") << ",\n";
+		out << "    \"presentMode\": " << JsonString(EngineSwapChain::presentModeName(engineRenderer.GetPresentMode())) << ",\n";
+		out << "    \"framesInFlight\": " << engineRenderer.GetFramesInFlight() << ",\n";
+		out << "    \"deferredShading\": " << (settings.deferredShading ? "true" : "false") << ",\n";
+		out << "    \"objects\": " << benchmarkSettings.objectCount << ",\n";
+		out << "    \"lights\": " << benchmarkSettings.lightCount << ",\n";
+		out << "    \"models\": [";
+		for (size_t i = 0; i < benchmarkSettings.models.size(); i++) {
+			out << (i > 0 ? ", " : "") << JsonString(benchmarkSettings.models[i]);
+		}
+		out << "],\n";
+		out << "    \"seed\": " << benchmarkSettings.seed << ",\n";
+		out << "    \"cameraPath\": " << JsonString(benchmarkSettings.cameraPathFile.empty() ? "orbit" : benchmarkSettings.cameraPathFile) << "\n";
+		out << "  },\n";
+		out << "  \"cpuMs\": ";
+		writeSummaries(cpuSamples);
+		out << ",\n  \"gpuMs\": ";
+		writeSummaries(gpuSamples);
+		out << "\n}\n";
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "first_app.hpp"
+#include "camera_path.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Engine {
+
+	// FirstApp driven by a camera path instead of the keyboard, over a generated scene, for a fixed
+	// number of frames with a fixed timestep. Reports frame time percentiles, CPU time per phase and
+	// GPU time per zone as JSON so runs of different engine versions can be compared
+	class BenchmarkApp : public FirstApp {
+	public:
+		struct BenchmarkSettings {
+			// headless and fixedTimeStep default to on, frameCount counts the warmup frames too
+			FirstApp::Settings app{ true, { WIDTH, HEIGHT }, 1000, 1.0f / 60.0f };
+			// Rendered but not measured, caches and allocators settle first
+			uint32_t warmupFrames = 60;
+			uint32_t objectCount = 100;
+			uint32_t lightCount = 16;
+			// Objects cycle through these models
+			std::vector<std::string> models{ "models/smooth_vase.obj", "models/flat_vase.obj" };
+			uint32_t seed = 1;
+			// Empty orbits the scene once over the run
+			std::string cameraPathFile;
+			// Windowed only, drives the camera with the keyboard and saves the path on exit
+			std::string recordPathFile;
+			// Empty writes the report to stdout
+			std::string outputFile;
+		};
+
+		explicit BenchmarkApp(const BenchmarkSettings& benchmarkSettings);
+
+		// Renders every frame, then writes the report or the recorded path
+		void RunBenchmark();
+
+	protected:
+		void loadGameObjects() override;
+		void updateCamera(float frameTime, EngineGameObject& viewerObject) override;
+		void onFrameComplete(const FrameTimings& timings) override;
+
+	private:
+		struct Summary {
+			double mean, min, p50, p90, p95, p99, max;
+		};
+
+		static Summary summarize(std::vector<double> samples);
+		// Deterministic on every platform, unlike the standard distributions
+		float random01();
+		void writeReport(std::ostream& out);
+
+		BenchmarkSettings benchmarkSettings;
+		CameraPath cameraPath;
+		float sceneTime = 0.0f;
+		float recordedTime = 0.0f;
+		float lastKeyTime = 0.0f;
+		uint32_t rngState;
+
+		// Milliseconds per measured frame, by phase name and GPU zone name
+		std::map<std::string, std::vector<double>> cpuSamples;
+		std::map<std::string, std::vector<double>> gpuSamples;
+	};
+}
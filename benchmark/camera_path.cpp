@@ -0,0 +1,119 @@
+#include "camera_path.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace Engine {
+
+	CameraPath CameraPath::LoadFromFile(const std::string& filePath) {
+		std::ifstream file{ filePath };
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open camera path: " + filePath);
+		}
+
+		CameraPath path{};
+		std::string line;
+		while (std::getline(file, line)) {
+			line = line.substr(0, line.find('#'));
+			std::istringstream stream{ line };
+			Key key{};
+			if (!(stream >> key.time))
+				continue;
+			if (!(stream >> key.translation.x >> key.translation.y >> key.translation.z
+				>> key.rotation.x >> key.rotation.y >> key.rotation.z)) {
+				throw std::runtime_error("Malformed camera path key in " + filePath + ": " + line);
+			}
+			path.AddKey(key);
+		}
+		if (path.IsEmpty()) {
+			throw std::runtime_error("Camera path has no keys: " + filePath);
+		}
+		return path;
+	}
+
+	CameraPath CameraPath::Orbit(float radius, float height, float duration, uint32_t keyCount) {
+		CameraPath path{};
+		for (uint32_t i = 0; i <= keyCount; i++) {
+			float angle = glm::two_pi<float>() * i / keyCount;
+			glm::vec3 position{ radius * std::sin(angle), height, -radius * std::cos(angle) };
+			// SetViewYXZ looks down (cos pitch sin yaw, -sin pitch, cos pitch cos yaw)
+			glm::vec3 direction = glm::normalize(-position);
+			Key key{};
+			key.time = duration * i / keyCount;
+			key.translation = position;
+			key.rotation = { -std::asin(direction.y), std::atan2(direction.x, direction.z), 0.0f };
+			path.AddKey(key);
+		}
+		return path;
+	}
+
+	void CameraPath::AddKey(const Key& key) {
+		if (keys.empty()) {
+			keys.push_back(key);
+			return;
+		}
+		if (key.time < keys.back().time) {
+			throw std::runtime_error("Camera path keys must be in time order");
+		}
+
+		// Interpolate yaw the short way around
+		Key unwrapped = key;
+		float previousYaw = keys.back().rotation.y;
+		while (unwrapped.rotation.y - previousYaw > glm::pi<float>())
+			unwrapped.rotation.y -= glm::two_pi<float>();
+		while (unwrapped.rotation.y - previousYaw < -glm::pi<float>())
+			unwrapped.rotation.y += glm::two_pi<float>();
+		keys.push_back(unwrapped);
+	}
+
+	void CameraPath::SaveToFile(const std::string& filePath) const {
+		std::ofstream file{ filePath };
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to write camera path: " + filePath);
+		}
+		file << "# time x y z pitch yaw roll\n";
+		for (auto& key : keys) {
+			file << key.time << ' '
+				<< key.translation.x << ' ' << key.translation.y << ' ' << key.translation.z << ' '
+				<< key.rotation.x << ' ' << key.rotation.y << ' ' << key.rotation.z << '\n';
+		}
+	}
+
+	void CameraPath::Sample(float time, TransformComponent& transform) const {
+		if (keys.empty())
+			return;
+
+		time = std::clamp(time, keys.front().time, keys.back().time);
+		auto next = std::upper_bound(keys.begin(), keys.end(), time,
+			[](float t, const Key& key) { return t < key.time; });
+		if (next == keys.end()) {
+			transform.translation = keys.back().translation;
+			transform.rotation = keys.back().rotation;
+			return;
+		}
+
+		// Segment p1 - p2, with the neighbours clamped at the ends
+		size_t i2 = static_cast<size_t>(next - keys.begin());
+		size_t i1 = i2 - 1;
+		size_t i0 = i1 > 0 ? i1 - 1 : i1;
+		size_t i3 = std::min(i2 + 1, keys.size() - 1);
+		float span = keys[i2].time - keys[i1].time;
+		float t = span > 0.0f ? (time - keys[i1].time) / span : 0.0f;
+
+		auto catmullRom = [t](const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) {
+			float t2 = t * t;
+			float t3 = t2 * t;
+			return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+				(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+		};
+		transform.translation = catmullRom(
+			keys[i0].translation, keys[i1].translation, keys[i2].translation, keys[i3].translation);
+		transform.rotation = catmullRom(
+			keys[i0].rotation, keys[i1].rotation, keys[i2].rotation, keys[i3].rotation);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "engine_game_object.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Engine {
+
+	// Viewer transform over time as a Catmull-Rom spline through timed keys. Sampled by scene time,
+	// so with a fixed timestep every run renders the same views regardless of frame rate
+	class CameraPath {
+	public:
+		struct Key {
+			float time;
+			glm::vec3 translation;
+			// Yaw (y) and pitch (x) as used by EngineCamera::SetViewYXZ
+			glm::vec3 rotation;
+		};
+
+		// One key per line, "time x y z pitch yaw roll", # starts a comment. Keys must be in time order
+		static CameraPath LoadFromFile(const std::string& filePath);
+		// Circles the origin at the given distance and height (negative y is up), looking at the origin
+		static CameraPath Orbit(float radius, float height, float duration, uint32_t keyCount = 16);
+
+		void AddKey(const Key& key);
+		void SaveToFile(const std::string& filePath) const;
+
+		// Holds the first and last key outside of the path's time range
+		void Sample(float time, TransformComponent& transform) const;
+		float GetDuration() const { return keys.empty() ? 0.0f : keys.back().time - keys.front().time; }
+		bool IsEmpty() const { return keys.empty(); }
+
+	private:
+		std::vector<Key> keys;
+	};
+}
@@ -0,0 +1,172 @@
+// Renders a generated scene along a camera path and prints frame timing statistics as JSON.
+// Usage: LearnVKBenchmark [options]
+//   --frames N          frames to render, warmup included (1000)
+//   --warmup N          frames rendered before measuring (60)
+//   --objects N         objects in the scene (100)
+//   --lights N          point lights in the scene (16)
+//   --models a.obj,...  models the objects cycle through
+//   --seed N            scene layout seed (1)
+//   --size WxH          render size (800x800)
+//   --timestep S        seconds per frame (1/60)
+//   --frames-in-flight N
+//   --windowed          render to a window instead of offscreen
+//   --deferred          deferred shading instead of forward
+//   --camera path.txt   camera path to follow instead of orbiting the scene
+//   --record path.txt   fly with the keyboard in a window and save the camera path, not with --camera
+//   --output report.json
+//   --trace trace.json  Chrome trace of the CPU profiler zones, needs -DENGINE_PROFILER=ON
+// Queue sort mode, times the transparent queue's radix sort without rendering:
+//   --sort-items N      items sorted per run (100000)
+//   --sort-runs N       runs (200), --seed and --output apply as well
+
+#include "benchmark_app.hpp"
+#include "queue_sort_benchmark.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace Engine;
+
+static std::vector<std::string> splitList(const std::string& list) {
+	std::vector<std::string> items;
+	std::istringstream stream{ list };
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		if (!item.empty())
+			items.push_back(item);
+	}
+	return items;
+}
+
+struct Options {
+	BenchmarkApp::BenchmarkSettings scene{};
+	// Set by any --sort-* option
+	bool queueSort = false;
+	QueueSortBenchmark queueSortBenchmark{};
+};
+
+static Options parseArguments(int argc, char** argv) {
+	Options options{};
+	auto& settings = options.scene;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--windowed") {
+			settings.app.headless = false;
+			continue;
+		}
+		if (option == "--deferred") {
+			settings.app.deferredShading = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			throw std::runtime_error("Missing value for " + option);
+		}
+
+		std::string value = argv[++i];
+		if (option == "--frames") {
+			settings.app.frameCount = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--warmup") {
+			settings.warmupFrames = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--objects") {
+			settings.objectCount = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--lights") {
+			settings.lightCount = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--models") {
+			settings.models = splitList(value);
+		}
+		else if (option == "--seed") {
+			settings.seed = static_cast<uint32_t>(std::stoul(value));
+			options.queueSortBenchmark.seed = settings.seed;
+		}
+		else if (option == "--size") {
+			size_t separator = value.find('x');
+			if (separator == std::string::npos) {
+				throw std::runtime_error("--size expects WIDTHxHEIGHT");
+			}
+			settings.app.extent.width = static_cast<uint32_t>(std::stoul(value.substr(0, separator)));
+			settings.app.extent.height = static_cast<uint32_t>(std::stoul(value.substr(separator + 1)));
+		}
+		else if (option == "--timestep") {
+			settings.app.fixedTimeStep = std::stof(value);
+		}
+		else if (option == "--frames-in-flight") {
+			settings.app.swapChain.framesInFlight = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--camera") {
+			settings.cameraPathFile = value;
+		}
+		else if (option == "--record") {
+			// Real time, until the window is closed
+			settings.recordPathFile = value;
+			settings.app.headless = false;
+			settings.app.frameCount = 0;
+			settings.app.fixedTimeStep = 0.0f;
+		}
+		else if (option == "--output") {
+			settings.outputFile = value;
+		}
+		else if (option == "--trace") {
+			settings.app.traceFile = value;
+		}
+		else if (option == "--sort-items") {
+			options.queueSort = true;
+			options.queueSortBenchmark.itemCount = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (option == "--sort-runs") {
+			options.queueSort = true;
+			options.queueSortBenchmark.runs = static_cast<uint32_t>(std::stoul(value));
+		}
+		else {
+			throw std::runtime_error("Unknown option " + option);
+		}
+	}
+
+	if (settings.app.swapChain.framesInFlight < 1 ||
+		settings.app.swapChain.framesInFlight > EngineSwapChain::MAX_FRAMES_IN_FLIGHT) {
+		throw std::runtime_error("--frames-in-flight must be between 1 and " +
+			std::to_string(EngineSwapChain::MAX_FRAMES_IN_FLIGHT));
+	}
+	if (settings.recordPathFile.empty() && settings.app.frameCount == 0) {
+		throw std::runtime_error("--frames must be at least 1");
+	}
+	if (options.queueSort && options.queueSortBenchmark.runs == 0) {
+		throw std::runtime_error("--sort-runs must be at least 1");
+	}
+	return options;
+}
+
+int main(int argc, char** argv) {
+	try {
+		Options options = parseArguments(argc, argv);
+		if (options.queueSort) {
+			if (options.scene.outputFile.empty()) {
+				options.queueSortBenchmark.Run(std::cout);
+			}
+			else {
+				std::ofstream file{ options.scene.outputFile };
+				if (!file.is_open()) {
+					throw std::runtime_error("Failed to write benchmark report: " + options.scene.outputFile);
+				}
+				options.queueSortBenchmark.Run(file);
+			}
+			return EXIT_SUCCESS;
+		}
+
+		BenchmarkApp app{ options.scene };
+		app.RunBenchmark();
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
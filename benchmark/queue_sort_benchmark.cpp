@@ -0,0 +1,60 @@
+#include "queue_sort_benchmark.hpp"
+
+#include "engine_render_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace Engine {
+
+	void QueueSortBenchmark::Run(std::ostream& out) const {
+		assert(runs > 0 && "Queue sort benchmark needs at least one run");
+
+		// xorshift32, the same depths on every platform
+		uint32_t state = seed != 0 ? seed : 1u;
+		std::vector<float> depths(itemCount);
+		for (auto& depth : depths) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			depth = 0.1f + (state >> 8) / 16777216.0f * 99.9f;
+		}
+
+		EngineTransparentQueue queue;
+		queue.Reserve(itemCount);
+		std::vector<double> samples;
+		for (uint32_t run = 0; run < runs; run++) {
+			queue.Clear();
+			for (uint32_t i = 0; i < itemCount; i++)
+				queue.Push(depths[i], i);
+
+			auto start = std::chrono::steady_clock::now();
+			queue.SortBackToFront();
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			for (size_t i = 1; i < queue.Size(); i++) {
+				if (queue[i - 1].key > queue[i].key)
+					throw std::runtime_error("Transparent queue sorted out of order");
+			}
+		}
+
+		double sum = 0.0;
+		for (double sample : samples)
+			sum += sample;
+		std::sort(samples.begin(), samples.end());
+		size_t count = samples.size();
+
+		out << "{\n";
+		out << "  \"items\": " << itemCount << ",\n";
+		out << "  \"runs\": " << runs << ",\n";
+		out << "  \"seed\": " << seed << ",\n";
+		out << "  \"sortMs\": { \"mean\": " << sum / count
+			<< ", \"min\": " << samples.front()
+			<< ", \"p50\": " << samples[(count - 1) / 2]
+			<< ", \"max\": " << samples.back() << " }\n";
+		out << "}\n";
+	}
+}
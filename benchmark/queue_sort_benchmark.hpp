@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+namespace Engine {
+
+	// Times EngineTransparentQueue::SortBackToFront on its own, without a device. The items are
+	// pushed from random depths between 0.1 and 100 once per run, only the sort is measured
+	struct QueueSortBenchmark {
+		uint32_t itemCount = 100000;
+		uint32_t runs = 200;
+		uint32_t seed = 1;
+
+		// Writes the sort times as JSON, throws if a run left the queue out of order. runs must be at least 1
+		void Run(std::ostream& out) const;
+	};
+}
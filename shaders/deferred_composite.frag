@@ -0,0 +1,27 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
+} ubo;
+
+// Set 2 is declared in full so it matches the renderer's G-buffer set layout
+layout(input_attachment_index = 0, set = 2, binding = 0) uniform subpassInput gBufferAlbedo;
+layout(input_attachment_index = 1, set = 2, binding = 1) uniform subpassInput gBufferNormal;
+layout(input_attachment_index = 2, set = 2, binding = 2) uniform subpassInput gBufferDepth;
+
+void main() {
+	// Background keeps the clear color
+	if (subpassLoad(gBufferDepth).r >= 1.0) {
+		discard;
+	}
+	vec3 albedo = subpassLoad(gBufferAlbedo).rgb;
+	outColor = vec4(ubo.ambientLightColor.xyz * ubo.ambientLightColor.w * albedo, 1.0);
+}
@@ -0,0 +1,81 @@
+#version 450
+
+layout(location = 0) flat in uint lightIndex;
+layout(location = 0) out vec4 outColor;
+
+layout(constant_id = 0) const bool ENABLE_SPECULAR = true;
+
+struct PointLight {
+	vec4 position; // w is range
+	vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
+} ubo;
+
+// Set 1 is declared in full so it shares its layout with the forward shader's light set
+layout(std430, set = 1, binding = 0) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer ClusterBuffer {
+	uvec2 clusterRanges[];
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer ClusterLightIndexBuffer {
+	uint clusterLightIndices[];
+};
+
+layout(input_attachment_index = 0, set = 2, binding = 0) uniform subpassInput gBufferAlbedo;
+layout(input_attachment_index = 1, set = 2, binding = 1) uniform subpassInput gBufferNormal;
+layout(input_attachment_index = 2, set = 2, binding = 2) uniform subpassInput gBufferDepth;
+
+// Inverts EngineCamera::SetPerspectiveProjection, view space looks down +z
+vec3 worldPositionFromDepth(float depth) {
+	vec2 ndc = gl_FragCoord.xy / ubo.screenSize * 2.0 - 1.0;
+	float viewZ = ubo.projection[3][2] / (depth - ubo.projection[2][2]);
+	vec3 positionView = vec3(ndc.x * viewZ / ubo.projection[0][0], ndc.y * viewZ / ubo.projection[1][1], viewZ);
+	return (ubo.inverseView * vec4(positionView, 1.0)).xyz;
+}
+
+void main() {
+	float depth = subpassLoad(gBufferDepth).r;
+	if (depth >= 1.0) {
+		discard;
+	}
+
+	PointLight light = lights[lightIndex];
+	vec3 fragPositionWorld = worldPositionFromDepth(depth);
+	vec3 directionToLight = light.position.xyz - fragPositionWorld;
+	float distanceSquared = dot(directionToLight, directionToLight);
+	float rangeSquared = light.position.w * light.position.w;
+	if (distanceSquared >= rangeSquared) {
+		discard;
+	}
+
+	vec3 albedo = subpassLoad(gBufferAlbedo).rgb;
+	vec3 surfaceNormal = normalize(subpassLoad(gBufferNormal).xyz * 2.0 - 1.0);
+	vec3 viewDirection = normalize(ubo.inverseView[3].xyz - fragPositionWorld);
+
+	// Same falloff as the forward shader
+	float falloff = clamp(1.0 - pow(distanceSquared / rangeSquared, 2.0), 0.0, 1.0);
+	float attenuation = falloff * falloff / distanceSquared;
+	directionToLight = normalize(directionToLight);
+	vec3 intensity = light.color.xyz * light.color.w * attenuation;
+	vec3 lighting = intensity * max(dot(surfaceNormal, directionToLight), 0);
+
+	if (ENABLE_SPECULAR) {
+		vec3 halfAngle = normalize(directionToLight + viewDirection);
+		float blinnTerm = pow(clamp(dot(surfaceNormal, halfAngle), 0, 1), 32.0);
+		lighting += intensity * blinnTerm;
+	}
+
+	outColor = vec4(lighting * albedo, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 450
+
+// Quad corners in [0, 1], stretched over the light's screen space bounds
+const vec2 CORNERS[6] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(0.0, 1.0),
+	vec2(0.0, 1.0),
+	vec2(1.0, 0.0),
+	vec2(1.0, 1.0)
+);
+
+layout(location = 0) flat out uint lightIndex;
+
+struct PointLight {
+	vec4 position; // w is range
+	vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
+} ubo;
+
+layout(std430, set = 1, binding = 0) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+void main() {
+	lightIndex = gl_InstanceIndex;
+	PointLight light = lights[gl_InstanceIndex];
+	vec3 center = (ubo.view * vec4(light.position.xyz, 1.0)).xyz;
+	float radius = light.position.w;
+
+	// Entirely outside the depth range, collapse the quad
+	if (center.z + radius <= ubo.zNear || center.z - radius >= ubo.zFar) {
+		gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+		return;
+	}
+
+	// Same bounds as EngineLightClusters: the view space box clipped to the depth range, projected
+	float minDepth = max(center.z - radius, ubo.zNear);
+	float maxDepth = min(center.z + radius, ubo.zFar);
+	vec2 ndcMin = vec2(1.0e30);
+	vec2 ndcMax = vec2(-1.0e30);
+	for (int corner = 0; corner < 8; corner++) {
+		vec4 clip = ubo.projection * vec4(
+			center.x + ((corner & 1) != 0 ? radius : -radius),
+			center.y + ((corner & 2) != 0 ? radius : -radius),
+			(corner & 4) != 0 ? maxDepth : minDepth,
+			1.0);
+		vec2 ndc = clip.xy / clip.w;
+		ndcMin = min(ndcMin, ndc);
+		ndcMax = max(ndcMax, ndc);
+	}
+	ndcMin = clamp(ndcMin, vec2(-1.0), vec2(1.0));
+	ndcMax = clamp(ndcMax, vec2(-1.0), vec2(1.0));
+
+	gl_Position = vec4(mix(ndcMin, ndcMax, CORNERS[gl_VertexIndex]), 0.0, 1.0);
+}
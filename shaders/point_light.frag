@@ -1,28 +1,20 @@
 #version 450
 
 layout(location = 0) in vec2 fragOffset;
+layout(location = 1) flat in vec4 fragColor;
 layout(location = 0) out vec4 outColor;
 
 
-struct PointLight {
-	vec4 position; // ignore w
-	vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
   	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLight[10];
-	int numLight;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-  float radius;
-} push;
 
 const float M_PI = 3.1415926538;
 
@@ -32,5 +24,5 @@ void main() {
 		discard;
 	}
 	float cosDist = 0.5 * (cos(dist * M_PI) + 1.0);
-    outColor = vec4(push.color.xyz + cosDist, cosDist);
+    outColor = vec4(fragColor.xyz + cosDist, cosDist);
 }
\ No newline at end of file
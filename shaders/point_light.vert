@@ -11,37 +11,42 @@ const vec2 OFFSETS[6] = vec2[](
 
 
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) flat out vec4 fragColor;
 
 
-struct PointLight {
-	vec4 position; // ignore w
-	vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
   mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLight[10];
-	int numLight;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-  float radius;
-} push;
+struct PointLightBillboard {
+  vec4 position; // w is radius
+  vec4 color; // w is intensity
+};
+
+// Sorted back to front, one instance per light
+layout(std430, set = 1, binding = 0) readonly buffer BillboardBuffer {
+  PointLightBillboard billboards[];
+} billboardBuffer;
+
 
 void main() {
+    PointLightBillboard billboard = billboardBuffer.billboards[gl_InstanceIndex];
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = billboard.color;
 
     vec3 cameraRightWorld =  {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
     vec3 cameraUpWorld =  {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-    vec3 positionWorld = push.position.xyz 
-        + push.radius * fragOffset.x * cameraRightWorld 
-        + push.radius * fragOffset.y * cameraUpWorld;
+    float radius = billboard.position.w;
+    vec3 positionWorld = billboard.position.xyz 
+        + radius * fragOffset.x * cameraRightWorld 
+        + radius * fragOffset.y * cameraUpWorld;
     
     gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0); 
 }
\ No newline at end of file
@@ -6,8 +6,14 @@ layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 0) out vec4 outColor;
 
 
+layout(constant_id = 0) const bool ENABLE_SPECULAR = true;
+// Light cluster grid, see EngineLightClusters
+layout(constant_id = 1) const uint CLUSTER_X = 16;
+layout(constant_id = 2) const uint CLUSTER_Y = 16;
+layout(constant_id = 3) const uint CLUSTER_Z = 24;
+
 struct PointLight {
-	vec4 position; // ignore w
+	vec4 position; // w is range
 	vec4 color; // w is intensity
 };
 
@@ -16,14 +22,23 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLight[10];
-	int numLight;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
 } ubo;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
+layout(std430, set = 1, binding = 0) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+// offset, count into clusterLightIndices
+layout(std430, set = 1, binding = 1) readonly buffer ClusterBuffer {
+	uvec2 clusterRanges[];
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer ClusterLightIndexBuffer {
+	uint clusterLightIndices[];
+};
 
 
 void main() {
@@ -34,21 +49,34 @@ void main() {
 	vec3 cameraWorldSpace = ubo.inverseView[3].xyz;
 	vec3 viewDirection = normalize(cameraWorldSpace - fragPositionWorld);
 
-	for (int i = 0; i < ubo.numLight; i++) {
-		PointLight light = ubo.pointLight[i];
+	// Same slicing as EngineLightClusters::binLights
+	float viewDepth = (ubo.view * vec4(fragPositionWorld, 1.0)).z;
+	uvec3 cluster = uvec3(
+		uvec2(gl_FragCoord.xy / ubo.screenSize * vec2(CLUSTER_X, CLUSTER_Y)),
+		uint(max(log(viewDepth / ubo.zNear) * float(CLUSTER_Z) / log(ubo.zFar / ubo.zNear), 0.0)));
+	cluster = min(cluster, uvec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+	uvec2 clusterRange = clusterRanges[cluster.x + CLUSTER_X * (cluster.y + CLUSTER_Y * cluster.z)];
+
+	for (uint i = 0; i < clusterRange.y; i++) {
+		PointLight light = lights[clusterLightIndices[clusterRange.x + i]];
 		vec3 directionToLight = light.position.xyz - fragPositionWorld;
-		float attenuation = 1.0 / dot(directionToLight, directionToLight);
+		float distanceSquared = dot(directionToLight, directionToLight);
+		// Fade to zero at the light's range so the cluster cutoff leaves no seams
+		float falloff = clamp(1.0 - pow(distanceSquared / (light.position.w * light.position.w), 2.0), 0.0, 1.0);
+		float attenuation = falloff * falloff / distanceSquared;
 		directionToLight = normalize(directionToLight);
 		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
 		vec3 intensity = light.color.xyz * light.color.w * attenuation;
 		diffuseLight += intensity * cosAngIncidence;
 
 		// specular lighting
-		vec3 halfAngle = normalize(directionToLight + viewDirection);
-		float blinnTerm = dot(surfaceNormal, halfAngle);
-		blinnTerm = clamp(blinnTerm, 0, 1);
-		blinnTerm = pow(blinnTerm, 32.0); // higher values -> shaper highlight
-		specularLight += intensity * blinnTerm;
+		if (ENABLE_SPECULAR) {
+			vec3 halfAngle = normalize(directionToLight + viewDirection);
+			float blinnTerm = dot(surfaceNormal, halfAngle);
+			blinnTerm = clamp(blinnTerm, 0, 1);
+			blinnTerm = pow(blinnTerm, 32.0); // higher values -> shaper highlight
+			specularLight += intensity * blinnTerm;
+		}
 	}
 
 
@@ -11,30 +11,39 @@ layout(location = 2) out vec3 fragNormalWorld;
 
 
 
-struct PointLight {
-	vec4 position; // ignore w
-	vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
  	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLight[10];
-	int numLight;
+	vec2 screenSize;
+	float zNear;
+	float zFar;
 } ubo;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
+struct ObjectData {
+	vec4 modelRows[3]; // rows of the affine model matrix
+};
+
+// Indexed by the draw's firstInstance, see EngineObjectBuffer
+layout(std430, set = 2, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
 
 void main() {
-	vec4 worldPosition = push.modelMatrix * vec4(position, 1.0);
+	ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+	mat4 modelMatrix = transpose(mat4(object.modelRows[0], object.modelRows[1], object.modelRows[2], vec4(0.0, 0.0, 0.0, 1.0)));
+	vec4 worldPosition = modelMatrix * vec4(position, 1.0);
 	gl_Position = ubo.projection * ubo.view * worldPosition; 
 
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	// The model matrix is rotation * scale, its inverse transpose is rotation / scale,
+	// which is the matrix with every column divided by its squared length
+	mat3 linear = mat3(modelMatrix);
+	mat3 normalMatrix = mat3(
+		linear[0] / dot(linear[0], linear[0]),
+		linear[1] / dot(linear[1], linear[1]),
+		linear[2] / dot(linear[2], linear[2]));
+	fragNormalWorld = normalize(normalMatrix * normal);
 	fragPosWorld = worldPosition.xyz;
 	fragColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "engine_bindless_table.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace Engine {
+
+	static constexpr VkDescriptorType BINDLESS_DESCRIPTOR_TYPES[BINDLESS_BINDING_COUNT] = {
+		VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		VK_DESCRIPTOR_TYPE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	};
+
+	EngineBindlessTable::EngineBindlessTable(EngineDevice& device, int framesInFlight) : engineDevice(device) {
+		if (!engineDevice.supportsBindless()) {
+			throw std::runtime_error("Device doesn't support the descriptor indexing features bindless needs!");
+		}
+
+		// Arrays are capped by the update after bind limits, which are per set and per stage
+		auto& limits = engineDevice.descriptorIndexingProperties;
+		arrays[BINDLESS_SAMPLED_IMAGES].capacity = std::min({ MAX_SAMPLED_IMAGES,
+			limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+		arrays[BINDLESS_SAMPLERS].capacity = std::min({ MAX_SAMPLERS,
+			limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+		arrays[BINDLESS_STORAGE_BUFFERS].capacity = std::min({ MAX_STORAGE_BUFFERS,
+			limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+		// All arrays are visible to every stage, so together with the other sets of a pipeline layout they
+		// also have to fit maxPerStageUpdateAfterBindResources. Shrink them in proportion when they don't
+		uint64_t stageBudget = limits.maxPerStageUpdateAfterBindResources > RESERVED_STAGE_RESOURCES
+			? limits.maxPerStageUpdateAfterBindResources - RESERVED_STAGE_RESOURCES : 0;
+		uint64_t total = 0;
+		for (auto& array : arrays)
+			total += array.capacity;
+		if (total > stageBudget) {
+			for (auto& array : arrays) {
+				array.capacity = static_cast<uint32_t>(array.capacity * stageBudget / total);
+			}
+		}
+		for (auto& array : arrays) {
+			if (array.capacity == 0) {
+				throw std::runtime_error("Device has no room for the bindless descriptor arrays!");
+			}
+		}
+
+		// Partially bound: unwritten slots are fine as long as no shader reads them.
+		// Unused while pending: slots the GPU doesn't read can be written while frames are in flight
+		VkDescriptorBindingFlags bindingFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		EngineDescriptorSetLayout::Builder builder{ engineDevice };
+		for (uint32_t binding = 0; binding < BINDLESS_BINDING_COUNT; binding++) {
+			arrays[binding].pendingRelease.resize(framesInFlight);
+			builder.addBinding(binding, BINDLESS_DESCRIPTOR_TYPES[binding], VK_SHADER_STAGE_ALL_GRAPHICS,
+				arrays[binding].capacity, bindingFlags);
+		}
+		setLayout = builder
+			.setLayoutFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT)
+			.build();
+	}
+
+	EngineBindlessTable::~EngineBindlessTable() {
+		if (descriptorPool != VK_NULL_HANDLE)
+			vkDestroyDescriptorPool(engineDevice.device(), descriptorPool, nullptr);
+	}
+
+	void EngineBindlessTable::createDescriptorSet() {
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (uint32_t binding = 0; binding < BINDLESS_BINDING_COUNT; binding++) {
+			poolSizes.push_back({ BINDLESS_DESCRIPTOR_TYPES[binding], arrays[binding].capacity });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(engineDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		if (vkAllocateDescriptorSets(engineDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate bindless descriptor set!");
+		}
+	}
+
+	void EngineBindlessTable::BeginFrame(int frameIndex) {
+		currentFrame = frameIndex;
+		ReleaseFrame(frameIndex);
+	}
+
+	void EngineBindlessTable::ReleaseFrame(int frameIndex) {
+		// Nothing was ever added, so nothing can be pending
+		if (descriptorSet == VK_NULL_HANDLE)
+			return;
+		for (auto& array : arrays) {
+			auto& released = array.pendingRelease[frameIndex];
+			array.freeSlots.insert(array.freeSlots.end(), released.begin(), released.end());
+			released.clear();
+		}
+	}
+
+	uint32_t EngineBindlessTable::AddSampledImage(VkImageView imageView, VkImageLayout imageLayout) {
+		uint32_t index = acquireSlot(BINDLESS_SAMPLED_IMAGES);
+		UpdateSampledImage(index, imageView, imageLayout);
+		return index;
+	}
+
+	uint32_t EngineBindlessTable::AddSampler(VkSampler sampler) {
+		uint32_t index = acquireSlot(BINDLESS_SAMPLERS);
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = sampler;
+		writeDescriptor(BINDLESS_SAMPLERS, index, &imageInfo, nullptr);
+		return index;
+	}
+
+	uint32_t EngineBindlessTable::AddStorageBuffer(const VkDescriptorBufferInfo& bufferInfo) {
+		uint32_t index = acquireSlot(BINDLESS_STORAGE_BUFFERS);
+		UpdateStorageBuffer(index, bufferInfo);
+		return index;
+	}
+
+	void EngineBindlessTable::UpdateSampledImage(uint32_t index, VkImageView imageView, VkImageLayout imageLayout) {
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = imageView;
+		imageInfo.imageLayout = imageLayout;
+		writeDescriptor(BINDLESS_SAMPLED_IMAGES, index, &imageInfo, nullptr);
+	}
+
+	void EngineBindlessTable::UpdateStorageBuffer(uint32_t index, const VkDescriptorBufferInfo& bufferInfo) {
+		writeDescriptor(BINDLESS_STORAGE_BUFFERS, index, nullptr, &bufferInfo);
+	}
+
+	void EngineBindlessTable::Release(BindlessBinding binding, uint32_t index) {
+		assert(index < arrays[binding].nextUnused && "Releasing a bindless slot that was never added");
+		// Frames recorded up to now may still read the slot, it comes back when this frame slot begins again
+		arrays[binding].pendingRelease[currentFrame].push_back(index);
+	}
+
+	uint32_t EngineBindlessTable::GetUsedCount(BindlessBinding binding) const {
+		auto& array = arrays[binding];
+		uint32_t pending = 0;
+		for (auto& released : array.pendingRelease)
+			pending += static_cast<uint32_t>(released.size());
+		return array.nextUnused - static_cast<uint32_t>(array.freeSlots.size()) - pending;
+	}
+
+	uint32_t EngineBindlessTable::acquireSlot(BindlessBinding binding) {
+		if (descriptorSet == VK_NULL_HANDLE)
+			createDescriptorSet();
+		auto& array = arrays[binding];
+		if (!array.freeSlots.empty()) {
+			uint32_t index = array.freeSlots.back();
+			array.freeSlots.pop_back();
+			return index;
+		}
+		if (array.nextUnused >= array.capacity) {
+			throw std::runtime_error("Bindless descriptor array is full!");
+		}
+		return array.nextUnused++;
+	}
+
+	void EngineBindlessTable::writeDescriptor(BindlessBinding binding, uint32_t index,
+		const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo) {
+		assert(index < arrays[binding].nextUnused && "Bindless slot was never added");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = binding;
+		write.dstArrayElement = index;
+		write.descriptorType = BINDLESS_DESCRIPTOR_TYPES[binding];
+		write.descriptorCount = 1;
+		write.pImageInfo = imageInfo;
+		write.pBufferInfo = bufferInfo;
+		vkUpdateDescriptorSets(engineDevice.device(), 1, &write, 0, nullptr);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_descriptors.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Engine {
+
+	// Set number shaders declare the bindless arrays at
+	static constexpr uint32_t BINDLESS_SET = 3;
+
+	// Binding of each resource array in the bindless set, must match the shaders
+	enum BindlessBinding : uint32_t {
+		BINDLESS_SAMPLED_IMAGES = 0,	// texture2D[]
+		BINDLESS_SAMPLERS = 1,			// sampler[]
+		BINDLESS_STORAGE_BUFFERS = 2,	// buffer blocks[]
+		BINDLESS_BINDING_COUNT
+	};
+
+	// One descriptor set with large arrays of sampled images, samplers and storage buffers, bound once
+	// per frame. Resources are added to a free slot whose index the shaders use, e.g. through a material,
+	// so materials need no descriptor sets of their own. Slots are written with UPDATE_AFTER_BIND while
+	// the set stays bound, and a released slot is reused only once the frames that could read it finished.
+	// The pool and set are only created by the first Add, until then only the layout exists.
+	// Needs EngineDevice::supportsBindless
+	class EngineBindlessTable {
+	public:
+		static constexpr uint32_t MAX_SAMPLED_IMAGES = 16384;
+		static constexpr uint32_t MAX_SAMPLERS = 256;
+		static constexpr uint32_t MAX_STORAGE_BUFFERS = 16384;
+		// Per stage resources left to the other sets of a pipeline layout that includes the bindless set
+		static constexpr uint32_t RESERVED_STAGE_RESOURCES = 64;
+
+		EngineBindlessTable(EngineDevice& device, int framesInFlight);
+		~EngineBindlessTable();
+
+		EngineBindlessTable(const EngineBindlessTable&) = delete;
+		EngineBindlessTable& operator=(const EngineBindlessTable&) = delete;
+
+		// Returns releases of the frame slot to the free lists, the frame last recorded in it must have finished
+		void BeginFrame(int frameIndex);
+		// For a frame slot dropped by lowering the frames in flight, returns its releases without beginning it
+		void ReleaseFrame(int frameIndex);
+
+		// Each returns the slot to index the array with, throws when the array is full
+		uint32_t AddSampledImage(VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t AddSampler(VkSampler sampler);
+		uint32_t AddStorageBuffer(const VkDescriptorBufferInfo& bufferInfo);
+		// Repoints a slot, only valid for slots no frame in flight reads
+		void UpdateSampledImage(uint32_t index, VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void UpdateStorageBuffer(uint32_t index, const VkDescriptorBufferInfo& bufferInfo);
+		void Release(BindlessBinding binding, uint32_t index);
+
+		EngineDescriptorSetLayout& GetSetLayout() const { return *setLayout; }
+		// VK_NULL_HANDLE until something was added
+		VkDescriptorSet GetDescriptorSet() const { return descriptorSet; }
+		uint32_t GetCapacity(BindlessBinding binding) const { return arrays[binding].capacity; }
+		uint32_t GetUsedCount(BindlessBinding binding) const;
+
+	private:
+		struct SlotArray {
+			uint32_t capacity = 0;
+			// Slots never handed out start at nextUnused, released ones are reused first
+			uint32_t nextUnused = 0;
+			std::vector<uint32_t> freeSlots;
+			// Released per frame slot, waiting for that frame to finish
+			std::vector<std::vector<uint32_t>> pendingRelease;
+		};
+
+		void createDescriptorSet();
+		uint32_t acquireSlot(BindlessBinding binding);
+		void writeDescriptor(BindlessBinding binding, uint32_t index,
+			const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+		EngineDevice& engineDevice;
+		std::unique_ptr<EngineDescriptorSetLayout> setLayout;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		std::array<SlotArray, BINDLESS_BINDING_COUNT> arrays{};
+		int currentFrame = 0;
+	};
+}
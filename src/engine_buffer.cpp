@@ -49,8 +49,34 @@ namespace Engine {
 
     EngineBuffer::~EngineBuffer() {
         unmap();
-        vkDestroyBuffer(engineDevice.device(), buffer, nullptr);
-        vkFreeMemory(engineDevice.device(), memory, nullptr);
+        // Frames in flight may still read the buffer
+        engineDevice.deletionQueue().DestroyBuffer(buffer);
+        engineDevice.deletionQueue().FreeMemory(memory);
+    }
+
+    bool EngineBuffer::reserveMapped(
+        EngineDevice& device,
+        std::unique_ptr<EngineBuffer>& buffer,
+        VkDeviceSize instanceSize,
+        uint32_t count,
+        VkBufferUsageFlags usageFlags) {
+        if (buffer != nullptr && buffer->getInstanceCount() >= count) {
+            return false;
+        }
+
+        uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : 1;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+
+        buffer = std::make_unique<EngineBuffer>(
+            device,
+            instanceSize,
+            capacity,
+            usageFlags,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        buffer->map();
+        return true;
     }
 
     /**
@@ -2,6 +2,9 @@
 
 #include "engine_device.hpp"
 
+// std
+#include <memory>
+
 namespace Engine {
 
     class EngineBuffer {
@@ -18,6 +21,16 @@ namespace Engine {
         EngineBuffer(const EngineBuffer&) = delete;
         EngineBuffer& operator=(const EngineBuffer&) = delete;
 
+        // Replaces buffer with a mapped host visible one when it holds fewer than count instances.
+        // The capacity doubles so a steadily rising count doesn't reallocate every frame. Returns
+        // true when replaced, the contents are lost and descriptors have to be rewritten
+        static bool reserveMapped(
+            EngineDevice& device,
+            std::unique_ptr<EngineBuffer>& buffer,
+            VkDeviceSize instanceSize,
+            uint32_t count,
+            VkBufferUsageFlags usageFlags);
+
         VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         void unmap();
 
@@ -35,7 +48,7 @@ namespace Engine {
         void* getMappedMemory() const { return mapped; }
         uint32_t getInstanceCount() const { return instanceCount; }
         VkDeviceSize getInstanceSize() const { return instanceSize; }
-        VkDeviceSize getAlignmentSize() const { return instanceSize; }
+        VkDeviceSize getAlignmentSize() const { return alignmentSize; }
         VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
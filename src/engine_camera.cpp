@@ -13,6 +13,8 @@ namespace Engine {
 		projectionMatrix[3][0] = -(right + left) / (right - left);
 		projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 		projectionMatrix[3][2] = -near / (far - near);
+		nearPlane = near;
+		farPlane = far;
 	}
 
 	void EngineCamera::SetPerspectiveProjection(float fovy, float aspect, float near, float far) {
@@ -24,6 +26,8 @@ namespace Engine {
 		projectionMatrix[2][2] = far / (far - near);
 		projectionMatrix[2][3] = 1.f;
 		projectionMatrix[3][2] = -(far * near) / (far - near);
+		nearPlane = near;
+		farPlane = far;
 	}
 
 	void EngineCamera::SetViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up) {
@@ -21,10 +21,14 @@ namespace Engine {
 		const glm::mat4& GetView() const { return viewMatrix; }
 		const glm::mat4& GetInverseView() const { return inverseViewMatrix; }
 		const glm::vec3 GetPosition() const { return glm::vec3(inverseViewMatrix[3]); }
+		float GetNear() const { return nearPlane; }
+		float GetFar() const { return farPlane; }
 	private:
 		glm::mat4 projectionMatrix{ 1.0f };
 		glm::mat4 viewMatrix{ 1.0f };
 		glm::mat4 inverseViewMatrix{ 1.0f };
+		float nearPlane = 0.1f;
+		float farPlane = 100.0f;
 
 	};
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "engine_command_recorder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace Engine {
+
+	void EngineCommandRecorder::Reset(VkCommandBuffer commandBuffer) {
+		this->commandBuffer = commandBuffer;
+		stats = {};
+		Invalidate();
+	}
+
+	void EngineCommandRecorder::Invalidate() {
+		boundPipeline = VK_NULL_HANDLE;
+		boundSets.fill({});
+		boundVertexBuffers.fill({});
+		boundIndexBuffer = VK_NULL_HANDLE;
+		pushConstantLayout = VK_NULL_HANDLE;
+		pushConstantStages = 0;
+		pushConstantKnown.reset();
+	}
+
+	void EngineCommandRecorder::BindPipeline(VkPipeline pipeline) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		if (pipeline == boundPipeline) {
+			stats.pipelineBindsFiltered++;
+			return;
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		boundPipeline = pipeline;
+		stats.pipelineBinds++;
+	}
+
+	void EngineCommandRecorder::BindDescriptorSets(
+		VkPipelineLayout layout,
+		uint32_t firstSet,
+		uint32_t descriptorSetCount,
+		const VkDescriptorSet* descriptorSets,
+		uint32_t dynamicOffsetCount,
+		const uint32_t* dynamicOffsets) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		const uint32_t lastSet = firstSet + descriptorSetCount;
+		// Dynamic offsets can only be matched to their set when a single set is bound
+		const bool tracked = lastSet <= MAX_TRACKED_SETS &&
+			(dynamicOffsetCount == 0 || (descriptorSetCount == 1 && dynamicOffsetCount <= MAX_TRACKED_DYNAMIC_OFFSETS));
+
+		// Already bound sets at either end of the range are trimmed off
+		if (tracked) {
+			auto isBound = [&](uint32_t set) {
+				const BoundSet& bound = boundSets[set];
+				return bound.set == descriptorSets[set - firstSet] && bound.layout == layout &&
+					bound.dynamicOffsetCount == dynamicOffsetCount &&
+					std::equal(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets.begin());
+			};
+			uint32_t begin = firstSet;
+			uint32_t end = lastSet;
+			while (begin < end && isBound(begin))
+				begin++;
+			while (end > begin && isBound(end - 1))
+				end--;
+			if (begin == end) {
+				stats.descriptorSetBindsFiltered++;
+				return;
+			}
+			descriptorSets += begin - firstSet;
+			firstSet = begin;
+			descriptorSetCount = end - begin;
+		}
+
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			layout,
+			firstSet, descriptorSetCount,
+			descriptorSets,
+			dynamicOffsetCount, dynamicOffsets);
+		stats.descriptorSetBinds++;
+
+		// A different layout may have disturbed the other sets, keep only those bound with this one
+		for (auto& bound : boundSets) {
+			if (bound.layout != layout)
+				bound = {};
+		}
+		for (uint32_t set = firstSet; set < firstSet + descriptorSetCount && set < MAX_TRACKED_SETS; set++) {
+			BoundSet& bound = boundSets[set];
+			bound = {};
+			if (tracked) {
+				bound.set = descriptorSets[set - firstSet];
+				bound.layout = layout;
+				bound.dynamicOffsetCount = dynamicOffsetCount;
+				std::copy(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets.begin());
+			}
+		}
+	}
+
+	void EngineCommandRecorder::BindVertexBuffers(
+		uint32_t firstBinding,
+		uint32_t bindingCount,
+		const VkBuffer* buffers,
+		const VkDeviceSize* offsets) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		bool changed = firstBinding + bindingCount > MAX_TRACKED_VERTEX_BINDINGS;
+		for (uint32_t i = 0; i < bindingCount && !changed; i++) {
+			auto& bound = boundVertexBuffers[firstBinding + i];
+			changed = bound.buffer != buffers[i] || bound.offset != offsets[i];
+		}
+		if (!changed) {
+			stats.vertexBufferBindsFiltered++;
+			return;
+		}
+
+		vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+		stats.vertexBufferBinds++;
+		for (uint32_t i = 0; i < bindingCount && firstBinding + i < MAX_TRACKED_VERTEX_BINDINGS; i++)
+			boundVertexBuffers[firstBinding + i] = { buffers[i], offsets[i] };
+	}
+
+	void EngineCommandRecorder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		if (buffer == boundIndexBuffer && offset == boundIndexOffset && indexType == boundIndexType) {
+			stats.indexBufferBindsFiltered++;
+			return;
+		}
+		vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+		boundIndexBuffer = buffer;
+		boundIndexOffset = offset;
+		boundIndexType = indexType;
+		stats.indexBufferBinds++;
+	}
+
+	void EngineCommandRecorder::PushConstants(
+		VkPipelineLayout layout,
+		VkShaderStageFlags stages,
+		uint32_t offset,
+		uint32_t size,
+		const void* values) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		const bool tracked = offset + size <= MAX_TRACKED_PUSH_CONSTANT_BYTES;
+		if (layout != pushConstantLayout || stages != pushConstantStages) {
+			pushConstantLayout = layout;
+			pushConstantStages = stages;
+			pushConstantKnown.reset();
+		}
+		else if (tracked) {
+			bool unchanged = std::memcmp(pushConstantBytes.data() + offset, values, size) == 0;
+			for (uint32_t i = offset; i < offset + size && unchanged; i++)
+				unchanged = pushConstantKnown[i];
+			if (unchanged) {
+				stats.pushConstantsFiltered++;
+				return;
+			}
+		}
+
+		vkCmdPushConstants(commandBuffer, layout, stages, offset, size, values);
+		stats.pushConstants++;
+		if (tracked) {
+			std::memcpy(pushConstantBytes.data() + offset, values, size);
+			for (uint32_t i = offset; i < offset + size; i++)
+				pushConstantKnown[i] = true;
+		}
+	}
+
+	void EngineCommandRecorder::PushDescriptorSet(
+		PFN_vkCmdPushDescriptorSetKHR pushDescriptorSet,
+		VkPipelineLayout layout,
+		uint32_t set,
+		uint32_t writeCount,
+		const VkWriteDescriptorSet* writes) {
+		assert(commandBuffer != VK_NULL_HANDLE && "Command recorder used before Reset");
+		assert(pushDescriptorSet != nullptr && "Push descriptors aren't supported by the device");
+		pushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, writeCount, writes);
+		stats.pushDescriptorSets++;
+
+		// Disturbs sets like a bind with this layout, and the pushed set matches no tracked handle
+		for (auto& bound : boundSets) {
+			if (bound.layout != layout)
+				bound = {};
+		}
+		if (set < MAX_TRACKED_SETS)
+			boundSets[set] = {};
+	}
+
+	void EngineCommandRecorder::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+		vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		stats.draws++;
+	}
+
+	void EngineCommandRecorder::DrawIndexed(
+		uint32_t indexCount,
+		uint32_t instanceCount,
+		uint32_t firstIndex,
+		int32_t vertexOffset,
+		uint32_t firstInstance) {
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		stats.draws++;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+namespace Engine {
+
+	// Records into a command buffer through a shadow of its bound state and drops binds and
+	// push constants that wouldn't change anything. Draws go through unchanged.
+	// The shadow only knows about commands recorded through the recorder, call Invalidate after
+	// recording state changes on the raw command buffer.
+	// Descriptor sets and push constants are only considered unchanged under the same pipeline
+	// layout handle, the layout cache hands out one handle per distinct layout. Sets with dynamic
+	// offsets are only filtered when bound one set per call
+	class EngineCommandRecorder {
+	public:
+		static constexpr uint32_t MAX_TRACKED_SETS = 8;
+		static constexpr uint32_t MAX_TRACKED_VERTEX_BINDINGS = 8;
+		static constexpr uint32_t MAX_TRACKED_PUSH_CONSTANT_BYTES = 256;
+		static constexpr uint32_t MAX_TRACKED_DYNAMIC_OFFSETS = 4;
+
+		// Issued commands reached the command buffer, filtered ones were dropped
+		struct Stats {
+			uint32_t pipelineBinds = 0;
+			uint32_t pipelineBindsFiltered = 0;
+			uint32_t descriptorSetBinds = 0;
+			uint32_t descriptorSetBindsFiltered = 0;
+			uint32_t vertexBufferBinds = 0;
+			uint32_t vertexBufferBindsFiltered = 0;
+			uint32_t indexBufferBinds = 0;
+			uint32_t indexBufferBindsFiltered = 0;
+			uint32_t pushConstants = 0;
+			uint32_t pushConstantsFiltered = 0;
+			uint32_t pushDescriptorSets = 0;
+			uint32_t draws = 0;
+
+			uint32_t Issued() const {
+				return pipelineBinds + descriptorSetBinds + vertexBufferBinds + indexBufferBinds + pushConstants +
+					pushDescriptorSets + draws;
+			}
+			uint32_t Filtered() const {
+				return pipelineBindsFiltered + descriptorSetBindsFiltered + vertexBufferBindsFiltered +
+					indexBufferBindsFiltered + pushConstantsFiltered;
+			}
+		};
+
+		EngineCommandRecorder() = default;
+		EngineCommandRecorder(const EngineCommandRecorder&) = delete;
+		EngineCommandRecorder& operator=(const EngineCommandRecorder&) = delete;
+
+		// Starts tracking a freshly begun command buffer, clears the state and the stats
+		void Reset(VkCommandBuffer commandBuffer);
+		// Forgets the bound state, the next command of each kind is always recorded
+		void Invalidate();
+
+		VkCommandBuffer GetCommandBuffer() const { return commandBuffer; }
+		const Stats& GetStats() const { return stats; }
+
+		void BindPipeline(VkPipeline pipeline);
+		void BindDescriptorSets(
+			VkPipelineLayout layout,
+			uint32_t firstSet,
+			uint32_t descriptorSetCount,
+			const VkDescriptorSet* descriptorSets,
+			uint32_t dynamicOffsetCount = 0,
+			const uint32_t* dynamicOffsets = nullptr);
+		void BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+		void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* values);
+		// Never filtered, pushed contents aren't compared. pushDescriptorSet is EngineDevice::cmdPushDescriptorSetKHR
+		void PushDescriptorSet(
+			PFN_vkCmdPushDescriptorSetKHR pushDescriptorSet,
+			VkPipelineLayout layout,
+			uint32_t set,
+			uint32_t writeCount,
+			const VkWriteDescriptorSet* writes);
+
+		void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+		void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+	private:
+		struct BoundSet {
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			uint32_t dynamicOffsetCount = 0;
+			std::array<uint32_t, MAX_TRACKED_DYNAMIC_OFFSETS> dynamicOffsets{};
+		};
+
+		struct BoundVertexBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+		};
+
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		Stats stats{};
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		std::array<BoundSet, MAX_TRACKED_SETS> boundSets{};
+		std::array<BoundVertexBuffer, MAX_TRACKED_VERTEX_BINDINGS> boundVertexBuffers{};
+		VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize boundIndexOffset = 0;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+
+		VkPipelineLayout pushConstantLayout = VK_NULL_HANDLE;
+		VkShaderStageFlags pushConstantStages = 0;
+		std::array<unsigned char, MAX_TRACKED_PUSH_CONSTANT_BYTES> pushConstantBytes{};
+		// Bytes whose current value is known
+		std::bitset<MAX_TRACKED_PUSH_CONSTANT_BYTES> pushConstantKnown{};
+	};
+}
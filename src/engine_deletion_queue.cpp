@@ -0,0 +1,149 @@
+#include "engine_deletion_queue.hpp"
+
+#include <cstring>
+
+namespace Engine {
+
+	// Non-dispatchable handles are pointers or uint64_t depending on the platform
+	template <typename T>
+	static uint64_t toHandleBits(T handle) {
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(T));
+		return bits;
+	}
+
+	template <typename T>
+	static T fromHandleBits(uint64_t bits) {
+		T handle;
+		std::memcpy(&handle, &bits, sizeof(T));
+		return handle;
+	}
+
+	EngineDeletionQueue::EngineDeletionQueue(VkDevice device, EngineTimeline& timeline)
+		: device(device), timeline(timeline) {}
+
+	EngineDeletionQueue::~EngineDeletionQueue() {
+		Flush();
+	}
+
+	void EngineDeletionQueue::DestroyBuffer(VkBuffer buffer) { push(OBJECT_BUFFER, buffer); }
+	void EngineDeletionQueue::DestroyImage(VkImage image) { push(OBJECT_IMAGE, image); }
+	void EngineDeletionQueue::DestroyImageView(VkImageView imageView) { push(OBJECT_IMAGE_VIEW, imageView); }
+	void EngineDeletionQueue::DestroySampler(VkSampler sampler) { push(OBJECT_SAMPLER, sampler); }
+	void EngineDeletionQueue::FreeMemory(VkDeviceMemory memory) { push(OBJECT_MEMORY, memory); }
+	void EngineDeletionQueue::DestroyPipeline(VkPipeline pipeline) { push(OBJECT_PIPELINE, pipeline); }
+	void EngineDeletionQueue::DestroyFramebuffer(VkFramebuffer framebuffer) { push(OBJECT_FRAMEBUFFER, framebuffer); }
+	void EngineDeletionQueue::DestroyRenderPass(VkRenderPass renderPass) { push(OBJECT_RENDER_PASS, renderPass); }
+	void EngineDeletionQueue::DestroySemaphore(VkSemaphore semaphore) { push(OBJECT_SEMAPHORE, semaphore); }
+	void EngineDeletionQueue::DestroySwapchain(VkSwapchainKHR swapchain) { push(OBJECT_SWAPCHAIN, swapchain); }
+
+	void EngineDeletionQueue::FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet set) {
+		push(OBJECT_DESCRIPTOR_SET, set, toHandleBits(pool));
+	}
+
+	void EngineDeletionQueue::Defer(std::function<void()> release) {
+		std::lock_guard<std::mutex> lock(mutex);
+		unstamped.push_back({ OBJECT_CALLBACK, 0, 0, 0, std::move(release) });
+	}
+
+	template <typename T>
+	void EngineDeletionQueue::push(ObjectType type, T handle, uint64_t owner) {
+		if (handle == VK_NULL_HANDLE)
+			return;
+		std::lock_guard<std::mutex> lock(mutex);
+		unstamped.push_back({ type, toHandleBits(handle), owner, 0, {} });
+	}
+
+	void EngineDeletionQueue::Stamp(uint64_t timelineValue) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : unstamped) {
+			entry.timelineValue = timelineValue;
+			stamped.push_back(std::move(entry));
+		}
+		unstamped.clear();
+	}
+
+	void EngineDeletionQueue::Collect() {
+		std::deque<Entry> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stamped.empty())
+				return;
+			uint64_t completed = timeline.GetCompletedValue();
+			while (!stamped.empty() && stamped.front().timelineValue <= completed) {
+				finished.push_back(std::move(stamped.front()));
+				stamped.pop_front();
+			}
+		}
+		// Outside the lock, callbacks may queue more objects
+		for (auto& entry : finished)
+			destroy(entry);
+	}
+
+	void EngineDeletionQueue::Flush() {
+		timeline.WaitIdle();
+		// Callbacks may queue more objects, repeat until nothing is left
+		while (true) {
+			std::deque<Entry> finished;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.swap(stamped);
+				for (auto& entry : unstamped)
+					finished.push_back(std::move(entry));
+				unstamped.clear();
+			}
+			if (finished.empty())
+				break;
+			for (auto& entry : finished)
+				destroy(entry);
+		}
+	}
+
+	size_t EngineDeletionQueue::PendingCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return unstamped.size() + stamped.size();
+	}
+
+	void EngineDeletionQueue::destroy(const Entry& entry) {
+		switch (entry.type) {
+		case OBJECT_BUFFER:
+			vkDestroyBuffer(device, fromHandleBits<VkBuffer>(entry.handle), nullptr);
+			break;
+		case OBJECT_IMAGE:
+			vkDestroyImage(device, fromHandleBits<VkImage>(entry.handle), nullptr);
+			break;
+		case OBJECT_IMAGE_VIEW:
+			vkDestroyImageView(device, fromHandleBits<VkImageView>(entry.handle), nullptr);
+			break;
+		case OBJECT_SAMPLER:
+			vkDestroySampler(device, fromHandleBits<VkSampler>(entry.handle), nullptr);
+			break;
+		case OBJECT_MEMORY:
+			vkFreeMemory(device, fromHandleBits<VkDeviceMemory>(entry.handle), nullptr);
+			break;
+		case OBJECT_PIPELINE:
+			vkDestroyPipeline(device, fromHandleBits<VkPipeline>(entry.handle), nullptr);
+			break;
+		case OBJECT_FRAMEBUFFER:
+			vkDestroyFramebuffer(device, fromHandleBits<VkFramebuffer>(entry.handle), nullptr);
+			break;
+		case OBJECT_RENDER_PASS:
+			vkDestroyRenderPass(device, fromHandleBits<VkRenderPass>(entry.handle), nullptr);
+			break;
+		case OBJECT_SEMAPHORE:
+			vkDestroySemaphore(device, fromHandleBits<VkSemaphore>(entry.handle), nullptr);
+			break;
+		case OBJECT_SWAPCHAIN:
+			vkDestroySwapchainKHR(device, fromHandleBits<VkSwapchainKHR>(entry.handle), nullptr);
+			break;
+		case OBJECT_DESCRIPTOR_SET: {
+			VkDescriptorSet set = fromHandleBits<VkDescriptorSet>(entry.handle);
+			vkFreeDescriptorSets(device, fromHandleBits<VkDescriptorPool>(entry.owner), 1, &set);
+			break;
+		}
+		case OBJECT_CALLBACK:
+			entry.callback();
+			break;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "engine_timeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Engine {
+
+	// Destroys Vulkan objects once the GPU is done with them instead of right away.
+	// Objects queued are tagged with the timeline value of the next frame submission (Stamp),
+	// since the frame being recorded may still reference them, and destroyed by Collect once the
+	// timeline passed that value. Objects can then be dropped at any time without waiting for the device
+	class EngineDeletionQueue {
+	public:
+		EngineDeletionQueue(VkDevice device, EngineTimeline& timeline);
+		~EngineDeletionQueue();
+
+		EngineDeletionQueue(const EngineDeletionQueue&) = delete;
+		EngineDeletionQueue& operator=(const EngineDeletionQueue&) = delete;
+
+		void DestroyBuffer(VkBuffer buffer);
+		void DestroyImage(VkImage image);
+		void DestroyImageView(VkImageView imageView);
+		void DestroySampler(VkSampler sampler);
+		void FreeMemory(VkDeviceMemory memory);
+		void DestroyPipeline(VkPipeline pipeline);
+		void DestroyFramebuffer(VkFramebuffer framebuffer);
+		void DestroyRenderPass(VkRenderPass renderPass);
+		void DestroySemaphore(VkSemaphore semaphore);
+		void DestroySwapchain(VkSwapchainKHR swapchain);
+		// The pool needs VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+		void FreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet set);
+		// Anything else, e.g. returning a set to a cache
+		void Defer(std::function<void()> release);
+
+		// Tags everything queued since the last call with the value a frame was just submitted with
+		void Stamp(uint64_t timelineValue);
+		// Destroys what the GPU finished with, call once per frame
+		void Collect();
+		// Waits for all submitted work and destroys everything, stamped or not
+		void Flush();
+
+		size_t PendingCount();
+
+	private:
+		enum ObjectType {
+			OBJECT_BUFFER,
+			OBJECT_IMAGE,
+			OBJECT_IMAGE_VIEW,
+			OBJECT_SAMPLER,
+			OBJECT_MEMORY,
+			OBJECT_PIPELINE,
+			OBJECT_FRAMEBUFFER,
+			OBJECT_RENDER_PASS,
+			OBJECT_SEMAPHORE,
+			OBJECT_SWAPCHAIN,
+			OBJECT_DESCRIPTOR_SET,
+			OBJECT_CALLBACK,
+		};
+
+		struct Entry {
+			ObjectType type;
+			// Non-dispatchable handles, the second one is the pool of a descriptor set
+			uint64_t handle;
+			uint64_t owner;
+			uint64_t timelineValue;
+			std::function<void()> callback;
+		};
+
+		template <typename T>
+		void push(ObjectType type, T handle, uint64_t owner = 0);
+		void destroy(const Entry& entry);
+
+		VkDevice device;
+		EngineTimeline& timeline;
+		std::mutex mutex;
+		// Queued since the last Stamp, not tagged yet
+		std::vector<Entry> unstamped;
+		// Tagged, in increasing timeline order
+		std::deque<Entry> stamped;
+	};
+}
@@ -0,0 +1,124 @@
+#include "engine_descriptor_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace Engine {
+
+	std::vector<EngineDescriptorAllocator::PoolSizeRatio> EngineDescriptorAllocator::DefaultPoolSizeRatios() {
+		return {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3.0f },
+		};
+	}
+
+	EngineDescriptorAllocator::EngineDescriptorAllocator(
+		EngineDevice& device,
+		uint32_t frameCount,
+		std::vector<PoolSizeRatio> poolSizeRatios,
+		uint32_t initialSetsPerPool)
+		: engineDevice(device), poolSizeRatios(std::move(poolSizeRatios)), setsPerPool(initialSetsPerPool) {
+		slots.resize(std::max(frameCount, 1u));
+	}
+
+	EngineDescriptorAllocator::~EngineDescriptorAllocator() {
+		for (auto& slot : slots) {
+			for (auto pool : slot.pools)
+				vkDestroyDescriptorPool(engineDevice.device(), pool, nullptr);
+		}
+		for (auto pool : freePools)
+			vkDestroyDescriptorPool(engineDevice.device(), pool, nullptr);
+	}
+
+	void EngineDescriptorAllocator::BeginFrame(int frameIndex) {
+		assert(slots.size() > 1 && "BeginFrame on a persistent descriptor allocator");
+		currentSlot = static_cast<uint32_t>(frameIndex);
+		ReleaseFrame(frameIndex);
+	}
+
+	void EngineDescriptorAllocator::ReleaseFrame(int frameIndex) {
+		assert(slots.size() > 1 && "ReleaseFrame on a persistent descriptor allocator");
+		auto& slot = slots[frameIndex];
+
+		for (auto pool : slot.pools) {
+			vkResetDescriptorPool(engineDevice.device(), pool, 0);
+			freePools.push_back(pool);
+			stats.poolResets++;
+		}
+		stats.poolsInUse -= static_cast<uint32_t>(slot.pools.size());
+		stats.poolsFree += static_cast<uint32_t>(slot.pools.size());
+		stats.setsAllocated -= slot.setsAllocated;
+		slot.pools.clear();
+		slot.setsAllocated = 0;
+	}
+
+	VkDescriptorSet EngineDescriptorAllocator::Allocate(VkDescriptorSetLayout setLayout) {
+		auto& slot = slots[currentSlot];
+		if (slot.pools.empty())
+			slot.pools.push_back(acquirePool());
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = slot.pools.back();
+		allocInfo.pSetLayouts = &setLayout;
+		allocInfo.descriptorSetCount = 1;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(engineDevice.device(), &allocInfo, &set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+			// Current pool is full, the slot keeps it until it is reset
+			slot.pools.push_back(acquirePool());
+			allocInfo.descriptorPool = slot.pools.back();
+			result = vkAllocateDescriptorSets(engineDevice.device(), &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate descriptor set!");
+		}
+
+		slot.setsAllocated++;
+		stats.setsAllocated++;
+		return set;
+	}
+
+	VkDescriptorPool EngineDescriptorAllocator::acquirePool() {
+		stats.poolsInUse++;
+		if (!freePools.empty()) {
+			VkDescriptorPool pool = freePools.back();
+			freePools.pop_back();
+			stats.poolsFree--;
+			return pool;
+		}
+
+		VkDescriptorPool pool = createPool(setsPerPool);
+		setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+		return pool;
+	}
+
+	VkDescriptorPool EngineDescriptorAllocator::createPool(uint32_t maxSets) {
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto& ratio : poolSizeRatios) {
+			uint32_t count = static_cast<uint32_t>(ratio.ratio * maxSets);
+			poolSizes.push_back({ ratio.descriptorType, std::max(count, 1u) });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = maxSets;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(engineDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create descriptor pool!");
+		}
+		stats.poolsCreated++;
+		return pool;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "engine_device.hpp"
+
+#include <vector>
+
+namespace Engine {
+
+	// Descriptor sets from a growing list of pools instead of one fixed EngineDescriptorPool.
+	// An exhausted pool is retired and the next one is taken from the free list or created,
+	// each new pool holding twice the sets of the last one up to a cap.
+	// One allocator is one lifetime class:
+	//   frameCount 0: persistent, sets live as long as the allocator
+	//   frameCount N: per frame, sets belong to the frame slot passed to BeginFrame and all of
+	//                 that slot's pools are reset with vkResetDescriptorPool the next time the slot begins
+	class EngineDescriptorAllocator {
+	public:
+		// Descriptors of a type per set in a pool, pools hold maxSets * ratio of each type
+		struct PoolSizeRatio {
+			VkDescriptorType descriptorType;
+			float ratio;
+		};
+
+		struct Stats {
+			uint32_t poolsCreated = 0;
+			uint32_t poolsInUse = 0;
+			uint32_t poolsFree = 0;
+			// Live sets, per-frame sets count until their slot is reset
+			uint32_t setsAllocated = 0;
+			uint32_t poolResets = 0;
+		};
+
+		static std::vector<PoolSizeRatio> DefaultPoolSizeRatios();
+
+		EngineDescriptorAllocator(
+			EngineDevice& device,
+			uint32_t frameCount = 0,
+			std::vector<PoolSizeRatio> poolSizeRatios = DefaultPoolSizeRatios(),
+			uint32_t initialSetsPerPool = 64);
+		~EngineDescriptorAllocator();
+
+		EngineDescriptorAllocator(const EngineDescriptorAllocator&) = delete;
+		EngineDescriptorAllocator& operator=(const EngineDescriptorAllocator&) = delete;
+
+		// Per-frame allocators only. Recycles the slot's pools, the frame last recorded in it must have finished
+		void BeginFrame(int frameIndex);
+		// For a frame slot dropped by lowering the frames in flight, returns its pools to the free list
+		void ReleaseFrame(int frameIndex);
+		// Throws if the device can't allocate the set even from a fresh pool
+		VkDescriptorSet Allocate(VkDescriptorSetLayout setLayout);
+
+		EngineDevice& GetDevice() const { return engineDevice; }
+		const Stats& GetStats() const { return stats; }
+
+	private:
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		// Pools a lifetime slot allocates from, the last one is current
+		struct PoolList {
+			std::vector<VkDescriptorPool> pools;
+			uint32_t setsAllocated = 0;
+		};
+
+		VkDescriptorPool acquirePool();
+		VkDescriptorPool createPool(uint32_t maxSets);
+
+		EngineDevice& engineDevice;
+		std::vector<PoolSizeRatio> poolSizeRatios;
+		uint32_t setsPerPool;
+		// One list per frame slot, a single one when persistent
+		std::vector<PoolList> slots;
+		uint32_t currentSlot = 0;
+		std::vector<VkDescriptorPool> freePools;
+		Stats stats{};
+	};
+}
@@ -0,0 +1,134 @@
+#include "engine_descriptor_set_cache.hpp"
+
+#include <cstring>
+
+namespace Engine {
+
+	template <typename T>
+	static void appendKey(std::string& key, const T& value) {
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		key.append(bytes, sizeof(T));
+	}
+
+	// Non-dispatchable handles are pointers or uint64_t depending on the platform
+	template <typename T>
+	static uint64_t handleId(T handle) {
+		uint64_t id = 0;
+		std::memcpy(&id, &handle, sizeof(T));
+		return id;
+	}
+
+	EngineDescriptorSetCache::EngineDescriptorSetCache(EngineDescriptorAllocator& allocator, int framesInFlight)
+		: descriptorAllocator(allocator) {
+		pendingRecycle.resize(framesInFlight);
+	}
+
+	void EngineDescriptorSetCache::BeginFrame(int frameIndex) {
+		currentFrame = frameIndex;
+		ReleaseFrame(frameIndex);
+	}
+
+	void EngineDescriptorSetCache::ReleaseFrame(int frameIndex) {
+		for (auto& retired : pendingRecycle[frameIndex]) {
+			recycledSets[retired.setLayout].push_back(retired.set);
+		}
+		pendingRecycle[frameIndex].clear();
+	}
+
+	VkDescriptorSet EngineDescriptorSetCache::GetOrCreate(
+		const EngineDescriptorSetLayout& setLayout,
+		std::vector<VkWriteDescriptorSet> writes) {
+		VkDescriptorSetLayout layout = setLayout.getDescriptorSetLayout();
+
+		std::string key;
+		appendKey(key, handleId(layout));
+		for (auto& write : writes) {
+			appendKey(key, write.dstBinding);
+			appendKey(key, write.dstArrayElement);
+			appendKey(key, write.descriptorType);
+			for (uint32_t i = 0; i < write.descriptorCount; i++) {
+				if (write.pBufferInfo != nullptr) {
+					appendKey(key, handleId(write.pBufferInfo[i].buffer));
+					appendKey(key, write.pBufferInfo[i].offset);
+					appendKey(key, write.pBufferInfo[i].range);
+				}
+				if (write.pImageInfo != nullptr) {
+					appendKey(key, handleId(write.pImageInfo[i].sampler));
+					appendKey(key, handleId(write.pImageInfo[i].imageView));
+					appendKey(key, write.pImageInfo[i].imageLayout);
+				}
+			}
+		}
+
+		auto cached = sets.find(key);
+		if (cached != sets.end()) {
+			stats.hits++;
+			return cached->second.set;
+		}
+		stats.misses++;
+
+		VkDescriptorSet set = acquireSet(layout);
+		for (auto& write : writes) {
+			write.dstSet = set;
+			for (uint32_t i = 0; i < write.descriptorCount; i++) {
+				if (write.pBufferInfo != nullptr) {
+					dependents[RESOURCE_BUFFER][handleId(write.pBufferInfo[i].buffer)].push_back(key);
+				}
+				if (write.pImageInfo != nullptr) {
+					if (write.pImageInfo[i].imageView != VK_NULL_HANDLE)
+						dependents[RESOURCE_IMAGE_VIEW][handleId(write.pImageInfo[i].imageView)].push_back(key);
+					if (write.pImageInfo[i].sampler != VK_NULL_HANDLE)
+						dependents[RESOURCE_SAMPLER][handleId(write.pImageInfo[i].sampler)].push_back(key);
+				}
+			}
+		}
+		vkUpdateDescriptorSets(
+			descriptorAllocator.GetDevice().device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		sets.emplace(std::move(key), Entry{ set, layout });
+		return set;
+	}
+
+	void EngineDescriptorSetCache::InvalidateBuffer(VkBuffer buffer) {
+		invalidate(RESOURCE_BUFFER, handleId(buffer));
+	}
+
+	void EngineDescriptorSetCache::InvalidateImageView(VkImageView imageView) {
+		invalidate(RESOURCE_IMAGE_VIEW, handleId(imageView));
+	}
+
+	void EngineDescriptorSetCache::InvalidateSampler(VkSampler sampler) {
+		invalidate(RESOURCE_SAMPLER, handleId(sampler));
+	}
+
+	void EngineDescriptorSetCache::invalidate(ResourceKind kind, uint64_t handle) {
+		auto found = dependents[kind].find(handle);
+		if (found == dependents[kind].end())
+			return;
+
+		// Keys of sets another resource already dropped are simply not found anymore,
+		// other resources' lists keep such stale keys until they are invalidated themselves
+		for (auto& key : found->second) {
+			auto entry = sets.find(key);
+			if (entry == sets.end())
+				continue;
+			// Frames recorded up to now may still read the set
+			pendingRecycle[currentFrame].push_back({ entry->second.set, entry->second.setLayout });
+			sets.erase(entry);
+			stats.invalidated++;
+		}
+		dependents[kind].erase(found);
+	}
+
+	VkDescriptorSet EngineDescriptorSetCache::acquireSet(VkDescriptorSetLayout setLayout) {
+		auto recycled = recycledSets.find(setLayout);
+		if (recycled != recycledSets.end() && !recycled->second.empty()) {
+			VkDescriptorSet set = recycled->second.back();
+			recycled->second.pop_back();
+			stats.recycled++;
+			return set;
+		}
+		return descriptorAllocator.Allocate(setLayout);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+
+	// Hands out one descriptor set per distinct set of writes instead of a new set per build.
+	// Sets are keyed by the layout and the buffer/image infos written, so materials that bind the
+	// same resources share a set. The owner of a resource invalidates it before destroying it,
+	// every set referencing it is dropped and recycled once the frames that could read it finished
+	class EngineDescriptorSetCache {
+	public:
+		struct Stats {
+			uint32_t hits = 0;
+			uint32_t misses = 0;
+			uint32_t invalidated = 0;
+			uint32_t recycled = 0;
+		};
+
+		// New sets come from allocator, which has to outlive the cache
+		EngineDescriptorSetCache(EngineDescriptorAllocator& allocator, int framesInFlight);
+
+		EngineDescriptorSetCache(const EngineDescriptorSetCache&) = delete;
+		EngineDescriptorSetCache& operator=(const EngineDescriptorSetCache&) = delete;
+
+		// Makes sets invalidated while this frame slot was last recorded reusable, the frame must have finished
+		void BeginFrame(int frameIndex);
+		// For a frame slot dropped by lowering the frames in flight, recycles its sets without beginning it
+		void ReleaseFrame(int frameIndex);
+
+		// writes as collected by EngineDescriptorWriter, dstSet is ignored
+		VkDescriptorSet GetOrCreate(const EngineDescriptorSetLayout& setLayout, std::vector<VkWriteDescriptorSet> writes);
+
+		void InvalidateBuffer(VkBuffer buffer);
+		void InvalidateImageView(VkImageView imageView);
+		void InvalidateSampler(VkSampler sampler);
+
+		size_t Size() const { return sets.size(); }
+		const Stats& GetStats() const { return stats; }
+
+	private:
+		// Handles of different types may share values, each kind is tracked apart
+		enum ResourceKind { RESOURCE_BUFFER = 0, RESOURCE_IMAGE_VIEW, RESOURCE_SAMPLER, RESOURCE_KIND_COUNT };
+
+		struct Entry {
+			VkDescriptorSet set;
+			VkDescriptorSetLayout setLayout;
+		};
+
+		struct RetiredSet {
+			VkDescriptorSet set;
+			VkDescriptorSetLayout setLayout;
+		};
+
+		void invalidate(ResourceKind kind, uint64_t handle);
+		VkDescriptorSet acquireSet(VkDescriptorSetLayout setLayout);
+
+		EngineDescriptorAllocator& descriptorAllocator;
+		std::unordered_map<std::string, Entry> sets;
+		// Keys of the sets referencing each resource
+		std::array<std::unordered_map<uint64_t, std::vector<std::string>>, RESOURCE_KIND_COUNT> dependents;
+		// Invalidated per frame slot, waiting for that frame to finish
+		std::vector<std::vector<RetiredSet>> pendingRecycle;
+		std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> recycledSets;
+		int currentFrame = 0;
+		Stats stats{};
+	};
+}
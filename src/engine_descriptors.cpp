@@ -1,4 +1,7 @@
 #include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_descriptor_set_cache.hpp"
+#include "engine_command_recorder.hpp"
 
 // std
 #include <cassert>
@@ -12,7 +15,8 @@ namespace Engine {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count) {
+        uint32_t count,
+        VkDescriptorBindingFlags bindingFlags) {
         assert(bindings.count(binding) == 0 && "Binding already in use");
         VkDescriptorSetLayoutBinding layoutBinding{};
         layoutBinding.binding = binding;
@@ -20,27 +24,59 @@ namespace Engine {
         layoutBinding.descriptorCount = count;
         layoutBinding.stageFlags = stageFlags;
         bindings[binding] = layoutBinding;
+        if (bindingFlags != 0) {
+            this->bindingFlags[binding] = bindingFlags;
+        }
+        return *this;
+    }
+
+    EngineDescriptorSetLayout::Builder& EngineDescriptorSetLayout::Builder::setLayoutFlags(
+        VkDescriptorSetLayoutCreateFlags flags) {
+        layoutFlags = flags;
+        return *this;
+    }
+
+    EngineDescriptorSetLayout::Builder& EngineDescriptorSetLayout::Builder::usePushDescriptors() {
+        if (engineDevice.supportsPushDescriptors()) {
+            layoutFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+        }
         return *this;
     }
 
     std::unique_ptr<EngineDescriptorSetLayout> EngineDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<EngineDescriptorSetLayout>(engineDevice, bindings);
+        return std::make_unique<EngineDescriptorSetLayout>(engineDevice, bindings, bindingFlags, layoutFlags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     EngineDescriptorSetLayout::EngineDescriptorSetLayout(
-        EngineDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
-        : engineDevice{ device }, bindings{ bindings } {
+        EngineDevice& device,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags,
+        VkDescriptorSetLayoutCreateFlags layoutFlags)
+        : engineDevice{ device }, layoutFlags{ layoutFlags }, bindings{ bindings } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
         descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+        descriptorSetLayoutInfo.flags = layoutFlags;
+
+        // Binding flags need descriptor indexing, only chained when a binding uses them
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        }
 
         if (vkCreateDescriptorSetLayout(
             engineDevice.device(),
@@ -110,8 +146,7 @@ namespace Engine {
         allocInfo.pSetLayouts = &descriptorSetLayout;
         allocInfo.descriptorSetCount = 1;
 
-        // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-        // a new pool whenever an old pool fills up. But this is beyond our current scope
+        // Fixed size, EngineDescriptorAllocator builds a new pool whenever an old pool fills up
         if (vkAllocateDescriptorSets(engineDevice.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
             return false;
         }
@@ -133,7 +168,11 @@ namespace Engine {
     // *************** Descriptor Writer *********************
 
     EngineDescriptorWriter::EngineDescriptorWriter(EngineDescriptorSetLayout& setLayout, EngineDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+        : setLayout{ setLayout }, engineDevice{ pool.engineDevice }, pool{ &pool } {}
+
+    EngineDescriptorWriter::EngineDescriptorWriter(
+        EngineDescriptorSetLayout& setLayout, EngineDescriptorAllocator& allocator)
+        : setLayout{ setLayout }, engineDevice{ allocator.GetDevice() }, allocator{ &allocator } {}
 
     EngineDescriptorWriter& EngineDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -144,6 +183,12 @@ namespace Engine {
         assert(
             bindingDescription.descriptorCount == 1 &&
             "Binding single descriptor info, but binding expects multiple");
+        // The dynamic offset is added on top of offset + range, the whole buffer would overflow
+        assert(
+            ((bindingDescription.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC &&
+              bindingDescription.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) ||
+             bufferInfo->range != VK_WHOLE_SIZE) &&
+            "Dynamic buffer descriptors need an explicit range");
 
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -178,19 +223,44 @@ namespace Engine {
     }
 
     bool EngineDescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-        if (!success) {
+        if (allocator != nullptr) {
+            set = allocator->Allocate(setLayout.getDescriptorSetLayout());
+        }
+        else if (!pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)) {
             return false;
         }
         overwrite(set);
         return true;
     }
 
+    bool EngineDescriptorWriter::build(VkDescriptorSet& set, EngineDescriptorSetCache& cache) {
+        set = cache.GetOrCreate(setLayout, writes);
+        return true;
+    }
+
+    void EngineDescriptorWriter::push(EngineCommandRecorder& recorder, VkPipelineLayout pipelineLayout, uint32_t set) {
+        if (setLayout.isPushDescriptor()) {
+            recorder.PushDescriptorSet(
+                engineDevice.cmdPushDescriptorSetKHR,
+                pipelineLayout,
+                set,
+                static_cast<uint32_t>(writes.size()),
+                writes.data());
+            return;
+        }
+
+        VkDescriptorSet descriptorSet;
+        if (!build(descriptorSet)) {
+            throw std::runtime_error("failed to allocate fallback set for pushed descriptors!");
+        }
+        recorder.BindDescriptorSets(pipelineLayout, set, 1, &descriptorSet);
+    }
+
     void EngineDescriptorWriter::overwrite(VkDescriptorSet& set) {
         for (auto& write : writes) {
             write.dstSet = set;
         }
-        vkUpdateDescriptorSets(pool.engineDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(engineDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
     }
 
 }  // namespace Engine
\ No newline at end of file
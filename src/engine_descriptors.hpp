@@ -8,6 +8,10 @@
 
 namespace Engine {
 
+    class EngineDescriptorAllocator;
+    class EngineDescriptorSetCache;
+    class EngineCommandRecorder;
+
     class EngineDescriptorSetLayout {
     public:
         class Builder {
@@ -18,25 +22,39 @@ namespace Engine {
                 uint32_t binding,
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
-                uint32_t count = 1);
+                uint32_t count = 1,
+                VkDescriptorBindingFlags bindingFlags = 0);
+            Builder& setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags);
+            // Push descriptor layout if the device supports them, a regular one otherwise.
+            // Either way the set is written with EngineDescriptorWriter::push
+            Builder& usePushDescriptors();
             std::unique_ptr<EngineDescriptorSetLayout> build() const;
 
         private:
             EngineDevice& engineDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
         };
 
         EngineDescriptorSetLayout(
-            EngineDevice& EngineDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            EngineDevice& EngineDevice,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags = {},
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
         ~EngineDescriptorSetLayout();
         EngineDescriptorSetLayout(const EngineDescriptorSetLayout&) = delete;
         EngineDescriptorSetLayout& operator=(const EngineDescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        bool isPushDescriptor() const {
+            return (layoutFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) != 0;
+        }
 
     private:
         EngineDevice& engineDevice;
         VkDescriptorSetLayout descriptorSetLayout;
+        VkDescriptorSetLayoutCreateFlags layoutFlags;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
 
         friend class EngineDescriptorWriter;
@@ -86,16 +104,26 @@ namespace Engine {
     class EngineDescriptorWriter {
     public:
         EngineDescriptorWriter(EngineDescriptorSetLayout& setLayout, EngineDescriptorPool& pool);
+        // build() allocates from the allocator's current lifetime slot and never runs out of pool space
+        EngineDescriptorWriter(EngineDescriptorSetLayout& setLayout, EngineDescriptorAllocator& allocator);
 
         EngineDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         EngineDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
 
         bool build(VkDescriptorSet& set);
+        // Returns the cached set if these exact writes were built before, the writer's pool is not used
+        bool build(VkDescriptorSet& set, EngineDescriptorSetCache& cache);
         void overwrite(VkDescriptorSet& set);
+        // Binds the writes to set of pipelineLayout for the next draws. Records them straight into the
+        // command buffer for push descriptor layouts, otherwise builds a set from the writer's pool or
+        // allocator and binds it, construct the writer with a per-frame allocator for that fallback
+        void push(EngineCommandRecorder& recorder, VkPipelineLayout pipelineLayout, uint32_t set);
 
     private:
         EngineDescriptorSetLayout& setLayout;
-        EngineDescriptorPool& pool;
+        EngineDevice& engineDevice;
+        EngineDescriptorPool* pool = nullptr;
+        EngineDescriptorAllocator* allocator = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
     };
 
@@ -47,16 +47,27 @@ namespace Engine {
     }
 
     // class member functions
-    EngineDevice::EngineDevice(EngineWindow &window) : window{window} {
+    EngineDevice::EngineDevice(EngineWindow &window) : window{&window} { init(); }
+
+    EngineDevice::EngineDevice() { init(); }
+
+    void EngineDevice::init() {
       createInstance();
       setupDebugMessenger();
       createSurface();
       pickPhysicalDevice();
       createLogicalDevice();
       createCommandPool();
+      timeline_ = std::make_unique<EngineTimeline>(device_);
+      deletionQueue_ = std::make_unique<EngineDeletionQueue>(device_, *timeline_);
     }
 
     EngineDevice::~EngineDevice() {
+      // Waits for the GPU, then destroys everything still queued
+      deletionQueue_.reset();
+      // Completion callbacks may still free command buffers from the pool
+      timeline_->Drain();
+      timeline_.reset();
       vkDestroyCommandPool(device_, commandPool, nullptr);
       vkDestroyDevice(device_, nullptr);
 
@@ -64,7 +75,9 @@ namespace Engine {
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
       }
 
-      vkDestroySurfaceKHR(instance, surface_, nullptr);
+      if (surface_ != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface_, nullptr);
+      }
       vkDestroyInstance(instance, nullptr);
     }
 
@@ -79,7 +92,7 @@ namespace Engine {
       appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
       appInfo.pEngineName = "No Engine";
       appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-      appInfo.apiVersion = VK_API_VERSION_1_0;
+      appInfo.apiVersion = VK_API_VERSION_1_2;
 
       VkInstanceCreateInfo createInfo = {};
       createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -131,6 +144,61 @@ namespace Engine {
 
       vkGetPhysicalDeviceProperties(physicalDevice, &properties);
       std::cout << "physical device: " << properties.deviceName << std::endl;
+
+      queryDescriptorIndexingSupport();
+      pushDescriptorSupported = checkDeviceExtensionSupport(physicalDevice, {VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME});
+      queryPresentWaitSupport();
+    }
+
+    void EngineDevice::queryPresentWaitSupport() {
+      if (isHeadless() || properties.apiVersion < VK_API_VERSION_1_2 ||
+          !checkDeviceExtensionSupport(
+              physicalDevice,
+              {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME})) {
+        return;
+      }
+
+      VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+      presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+      VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+      presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+      presentIdFeatures.pNext = &presentWaitFeatures;
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &presentIdFeatures;
+      vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+      presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+    }
+
+    void EngineDevice::queryDescriptorIndexingSupport() {
+      // Core in 1.2, the feature structs can't be chained on older devices
+      if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return;
+      }
+
+      VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+      indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &indexingFeatures;
+      vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+      bindlessSupported = indexingFeatures.runtimeDescriptorArray &&
+                          indexingFeatures.descriptorBindingPartiallyBound &&
+                          indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                          indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                          indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                          indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                          indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+
+      descriptorIndexingProperties = {};
+      descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+      VkPhysicalDeviceProperties2 properties2 = {};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties2.pNext = &descriptorIndexingProperties;
+      vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+      descriptorIndexingProperties.pNext = nullptr;
     }
 
     void EngineDevice::createLogicalDevice() {
@@ -149,8 +217,41 @@ namespace Engine {
         queueCreateInfos.push_back(queueCreateInfo);
       }
 
-      VkPhysicalDeviceFeatures deviceFeatures = {};
-      deviceFeatures.samplerAnisotropy = VK_TRUE;
+      VkPhysicalDeviceFeatures2 deviceFeatures = {};
+      deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+
+      VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+      timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+      timelineFeatures.timelineSemaphore = VK_TRUE;
+      deviceFeatures.pNext = &timelineFeatures;
+
+      // What EngineBindlessTable needs: partially bound arrays updated while in use, indexed per fragment
+      VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+      indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+      if (bindlessSupported) {
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        timelineFeatures.pNext = &indexingFeatures;
+      }
+
+      // Lets EngineSwapChain tag presents and observe when they reach the screen
+      VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+      presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+      VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+      presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+      if (presentWaitSupported) {
+        presentIdFeatures.presentId = VK_TRUE;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        presentWaitFeatures.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &presentIdFeatures;
+      }
 
       VkDeviceCreateInfo createInfo = {};
       createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -158,9 +259,18 @@ namespace Engine {
       createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
       createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-      createInfo.pEnabledFeatures = &deviceFeatures;
-      createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-      createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      createInfo.pNext = &deviceFeatures;
+      createInfo.pEnabledFeatures = nullptr;
+      std::vector<const char *> enabledExtensions = getRequiredDeviceExtensions();
+      if (pushDescriptorSupported) {
+        enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+      }
+      if (presentWaitSupported) {
+        enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+      }
+      createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+      createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
       // might not really be necessary anymore because device specific validation layers
       // have been deprecated
@@ -177,6 +287,18 @@ namespace Engine {
 
       vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
       vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+      // Extension commands aren't exported by the loader
+      if (pushDescriptorSupported) {
+        cmdPushDescriptorSetKHR = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(
+            device_,
+            "vkCmdPushDescriptorSetKHR");
+        pushDescriptorSupported = cmdPushDescriptorSetKHR != nullptr;
+      }
+      if (presentWaitSupported) {
+        waitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR");
+        presentWaitSupported = waitForPresentKHR != nullptr;
+      }
     }
 
     void EngineDevice::createCommandPool() {
@@ -193,15 +315,20 @@ namespace Engine {
       }
     }
 
-    void EngineDevice::createSurface() { window.CreateWindowSurface(instance, &surface_); }
+    void EngineDevice::createSurface() {
+      if (window != nullptr) {
+        window->CreateWindowSurface(instance, &surface_);
+      }
+    }
 
     bool EngineDevice::isDeviceSuitable(VkPhysicalDevice device) {
       QueueFamilyIndices indices = findQueueFamilies(device);
 
       bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-      bool swapChainAdequate = false;
-      if (extensionsSupported) {
+      // Nothing is presented when headless
+      bool swapChainAdequate = isHeadless();
+      if (extensionsSupported && !isHeadless()) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
       }
@@ -209,8 +336,20 @@ namespace Engine {
       VkPhysicalDeviceFeatures supportedFeatures;
       vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+      // All queue work is synchronised on one timeline semaphore, core in 1.2
+      VkPhysicalDeviceProperties deviceProperties;
+      vkGetPhysicalDeviceProperties(device, &deviceProperties);
+      VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+      timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+      if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &timelineFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+      }
+
       return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-             supportedFeatures.samplerAnisotropy;
+             supportedFeatures.samplerAnisotropy && timelineFeatures.timelineSemaphore;
     }
 
     void EngineDevice::populateDebugMessengerCreateInfo(
@@ -261,11 +400,14 @@ namespace Engine {
     }
 
     std::vector<const char *> EngineDevice::getRequiredExtensions() {
-      uint32_t glfwExtensionCount = 0;
-      const char **glfwExtensions;
-      glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-      std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      // GLFW is never initialised when headless, and no surface extension is needed
+      std::vector<const char *> extensions;
+      if (!isHeadless()) {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      }
 
       if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -297,7 +439,19 @@ namespace Engine {
       }
     }
 
+    std::vector<const char *> EngineDevice::getRequiredDeviceExtensions() {
+      if (isHeadless()) {
+        return {};
+      }
+      return deviceExtensions;
+    }
+
     bool EngineDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
+      return checkDeviceExtensionSupport(device, getRequiredDeviceExtensions());
+    }
+
+    bool EngineDevice::checkDeviceExtensionSupport(
+        VkPhysicalDevice device, const std::vector<const char *> &extensions) {
       uint32_t extensionCount;
       vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
@@ -308,7 +462,7 @@ namespace Engine {
           &extensionCount,
           availableExtensions.data());
 
-      std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+      std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
       for (const auto &extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -332,8 +486,13 @@ namespace Engine {
           indices.graphicsFamily = i;
           indices.graphicsFamilyHasValue = true;
         }
+        // Headless "presents" on the graphics queue, nothing is queued to the present queue
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        if (isHeadless()) {
+          presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+        } else {
+          vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        }
         if (queueFamily.queueCount > 0 && presentSupport) {
           indices.presentFamily = i;
           indices.presentFamilyHasValue = true;
@@ -403,6 +562,17 @@ namespace Engine {
       throw std::runtime_error("failed to find suitable memory type!");
     }
 
+    bool EngineDevice::hasMemoryType(VkMemoryPropertyFlags properties) {
+      VkPhysicalDeviceMemoryProperties memProperties;
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+      for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+          return true;
+        }
+      }
+      return false;
+    }
+
     void EngineDevice::createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
@@ -460,12 +630,27 @@ namespace Engine {
       submitInfo.commandBufferCount = 1;
       submitInfo.pCommandBuffers = &commandBuffer;
 
-      vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-      vkQueueWaitIdle(graphicsQueue_);
+      // Waits for this submission only, frames in flight keep running
+      timeline_->Wait(timeline_->Submit(graphicsQueue_, submitInfo));
 
       vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
+    uint64_t EngineDevice::submitSingleTimeCommands(VkCommandBuffer commandBuffer) {
+      vkEndCommandBuffer(commandBuffer);
+
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &commandBuffer;
+
+      uint64_t value = timeline_->Submit(graphicsQueue_, submitInfo);
+      timeline_->OnComplete(value, [this, commandBuffer]() mutable {
+        vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+      });
+      return value;
+    }
+
     void EngineDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
       VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
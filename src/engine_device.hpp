@@ -1,8 +1,11 @@
 #pragma once
 
 #include "engine_window.hpp"
+#include "engine_timeline.hpp"
+#include "engine_deletion_queue.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -31,6 +34,8 @@ namespace Engine {
         #endif
 
         EngineDevice(EngineWindow &window);
+        // Headless: no GLFW, surface or swap chain extension, EngineSwapChain renders to offscreen images
+        EngineDevice();
         ~EngineDevice();
 
         // Not copyable or movable
@@ -41,12 +46,20 @@ namespace Engine {
 
         VkCommandPool getCommandPool() { return commandPool; }
         VkDevice device() { return device_; }
+        // VK_NULL_HANDLE when headless
         VkSurfaceKHR surface() { return surface_; }
+        bool isHeadless() const { return window == nullptr; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
+        // The graphics queue when headless
         VkQueue presentQueue() { return presentQueue_; }
+        // Signalled by every submission to the graphics queue
+        EngineTimeline &timeline() { return *timeline_; }
+        // Objects that may still be in use by submitted frames are destroyed through here
+        EngineDeletionQueue &deletionQueue() { return *deletionQueue_; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        bool hasMemoryType(VkMemoryPropertyFlags properties);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(
             const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
@@ -60,6 +73,8 @@ namespace Engine {
             VkDeviceMemory &bufferMemory);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+        // Doesn't wait, the returned timeline value completes with the commands
+        uint64_t submitSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
         void copyBufferToImage(
             VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
@@ -70,36 +85,60 @@ namespace Engine {
             VkImage &image,
             VkDeviceMemory &imageMemory);
 
+        // Descriptor indexing features EngineBindlessTable relies on, enabled when supported
+        bool supportsBindless() const { return bindlessSupported; }
+        // VK_KHR_push_descriptor, enabled when supported
+        bool supportsPushDescriptors() const { return pushDescriptorSupported; }
+        // Null without push descriptor support
+        PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSetKHR = nullptr;
+        // VK_KHR_present_id and VK_KHR_present_wait, enabled when both are supported, never when headless
+        bool supportsPresentWait() const { return presentWaitSupported; }
+        // Null without present wait support
+        PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
+
         VkPhysicalDeviceProperties properties;
+        // Zeroed unless the device supports Vulkan 1.2
+        VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties = {};
 
         private:
+        void init();
         void createInstance();
         void setupDebugMessenger();
         void createSurface();
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void queryDescriptorIndexingSupport();
+        void queryPresentWaitSupport();
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
         std::vector<const char *> getRequiredExtensions();
+        std::vector<const char *> getRequiredDeviceExtensions();
         bool checkValidationLayerSupport();
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char *> &extensions);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-        EngineWindow &window;
+        // Null when headless
+        EngineWindow *window = nullptr;
         VkCommandPool commandPool;
+        bool bindlessSupported = false;
+        bool pushDescriptorSupported = false;
+        bool presentWaitSupported = false;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        std::unique_ptr<EngineTimeline> timeline_;
+        std::unique_ptr<EngineDeletionQueue> deletionQueue_;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
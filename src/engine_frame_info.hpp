@@ -2,15 +2,30 @@
 
 #include "engine_camera.hpp"
 #include "engine_game_object.hpp"
+#include "engine_render_queue.hpp"
+#include "engine_command_recorder.hpp"
+#include "engine_object_buffer.hpp"
+#include "engine_descriptor_allocator.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace Engine {
 
-	#define MAX_LIGHTS 10
+	// layout(constant_id = ...) ids shared with the shaders
+	enum SpecializationConstantId : uint32_t {
+		SPEC_ENABLE_SPECULAR = 0,	// VkBool32
+		SPEC_CLUSTER_X = 1,			// light cluster grid dimensions, see EngineLightClusters
+		SPEC_CLUSTER_Y = 2,
+		SPEC_CLUSTER_Z = 3,
+	};
+
+	// Irradiance below which a light is cut off, sets the range lights are binned with
+	constexpr float LIGHT_CUTOFF_INTENSITY = 0.002f;
+
+	// std430 element of the light storage buffer
 	struct PointLight{
-		glm::vec4 position{};
-		glm::vec4 color{};
+		glm::vec4 position{}; // w is range
+		glm::vec4 color{}; // w is intensity
 	};
 
 	struct GlobalUbo {
@@ -18,16 +33,34 @@ namespace Engine {
 		glm::mat4 view{ 1.0f };
 		glm::mat4 inverseViewMatrix { 1.0f };
 		glm::vec4 ambientLightColor;
-		PointLight pointLights[MAX_LIGHTS];
-		int numLights;
+		// Maps fragments to their light cluster
+		glm::vec2 screenSize{};
+		float zNear;
+		float zFar;
 	};
 
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
 		VkCommandBuffer commandBuffer;
+		// Preferred over commandBuffer for binds, push constants and draws
+		EngineCommandRecorder& recorder;
 		EngineCamera& camera;
+		// Shared by every frame, GlobalUbo is the UNIFORM_BUFFER_DYNAMIC at globalUboOffset
 		VkDescriptorSet globalDescriptorSet;
+		uint32_t globalUboOffset;
+		VkDescriptorSet lightDescriptorSet;
+		// Set 2 of the geometry shaders, objects are found with objectBuffer.GetObjectIndex
+		VkDescriptorSet objectDescriptorSet;
+		const EngineObjectBuffer& objectBuffer;
+		// Deferred path only, VK_NULL_HANDLE when rendering forward
+		VkDescriptorSet gBufferDescriptorSet;
+		// BINDLESS_SET for shaders that declare it, VK_NULL_HANDLE without descriptor indexing or while it's empty
+		VkDescriptorSet bindlessDescriptorSet;
 		EngineGameObject::Map& gameObjects;
+		// Opaque draws collected by the systems, flushed by the caller inside the render pass
+		EngineDrawQueue& drawQueue;
+		// Transient per-draw sets, valid until this frame slot is reused
+		EngineDescriptorAllocator& frameDescriptorAllocator;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "engine_gpu_timer.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace Engine {
+
+	EngineGpuTimer::EngineGpuTimer(EngineDevice& device) : engineDevice(device) {
+		// Timestamps on the graphics queue are optional before Vulkan 1.3
+		if (!engineDevice.properties.limits.timestampComputeAndGraphics)
+			return;
+		timestampPeriod = engineDevice.properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = QUERIES_PER_FRAME * EngineSwapChain::MAX_FRAMES_IN_FLIGHT;
+		if (vkCreateQueryPool(engineDevice.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+		timestamps.resize(QUERIES_PER_FRAME);
+	}
+
+	EngineGpuTimer::~EngineGpuTimer() {
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(engineDevice.device(), queryPool, nullptr);
+		}
+	}
+
+	bool EngineGpuTimer::BeginFrame(int frameIndex, VkCommandBuffer commandBuffer, uint64_t frameNumber) {
+		if (!IsSupported())
+			return false;
+
+		currentFrameIndex = frameIndex;
+		auto& frame = frames[frameIndex];
+		bool hasResults = false;
+		if (!frame.names.empty()) {
+			hasResults = readResults(frameIndex);
+			frame.names.clear();
+		}
+		frame.frameNumber = frameNumber;
+
+		// Queries have to be reset before they're written again, the first frame resets them too
+		vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+		return hasResults;
+	}
+
+	uint32_t EngineGpuTimer::BeginZone(VkCommandBuffer commandBuffer, const char* name) {
+		auto& frame = frames[currentFrameIndex];
+		uint32_t zone = static_cast<uint32_t>(frame.names.size());
+		if (!IsSupported() || zone >= MAX_ZONES)
+			return MAX_ZONES;
+
+		frame.names.push_back(name);
+		vkCmdWriteTimestamp(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			queryPool,
+			currentFrameIndex * QUERIES_PER_FRAME + zone * 2);
+		return zone;
+	}
+
+	void EngineGpuTimer::EndZone(VkCommandBuffer commandBuffer, uint32_t zone) {
+		if (zone >= MAX_ZONES)
+			return;
+		assert(zone < frames[currentFrameIndex].names.size() && "Zone wasn't begun this frame");
+
+		vkCmdWriteTimestamp(
+			commandBuffer,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			queryPool,
+			currentFrameIndex * QUERIES_PER_FRAME + zone * 2 + 1);
+	}
+
+	bool EngineGpuTimer::readResults(int frameIndex) {
+		auto& frame = frames[frameIndex];
+		uint32_t queryCount = static_cast<uint32_t>(frame.names.size()) * 2;
+
+		// The frame finished, but a zone that was never ended leaves its query unavailable
+		VkResult result = vkGetQueryPoolResults(
+			engineDevice.device(),
+			queryPool,
+			frameIndex * QUERIES_PER_FRAME,
+			queryCount,
+			queryCount * sizeof(uint64_t),
+			timestamps.data(),
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+			return false;
+
+		results.clear();
+		resultsFrameNumber = frame.frameNumber;
+		for (size_t i = 0; i < frame.names.size(); i++) {
+			uint64_t ticks = timestamps[i * 2 + 1] - timestamps[i * 2];
+			results.push_back({ frame.names[i], ticks * timestampPeriod / 1000000.0 });
+		}
+		return true;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_swap_chain.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Engine {
+
+	// GPU time of named command buffer ranges, from timestamp queries written around them.
+	// Each frame slot owns a range of one query pool. Its results are read when the slot comes
+	// around again, so they lag the recorded frame by the frames in flight and never stall.
+	// Does nothing on devices without graphics queue timestamps
+	class EngineGpuTimer {
+	public:
+		static constexpr uint32_t MAX_ZONES = 16;
+
+		struct Zone {
+			// Not copied, pass string literals
+			const char* name;
+			double milliseconds;
+		};
+
+		explicit EngineGpuTimer(EngineDevice& device);
+		~EngineGpuTimer();
+
+		EngineGpuTimer(const EngineGpuTimer&) = delete;
+		EngineGpuTimer& operator=(const EngineGpuTimer&) = delete;
+
+		// Call right after the frame's command buffer began, outside any render pass. The frame last
+		// recorded in the slot must have finished. Returns true when it left new results.
+		// frameNumber is the caller's, the results are tagged with it once read back
+		bool BeginFrame(int frameIndex, VkCommandBuffer commandBuffer, uint64_t frameNumber = 0);
+		// For a frame slot dropped by lowering the frames in flight, discards its zones so the slot
+		// doesn't report them as new results once it's used again
+		void ReleaseFrame(int frameIndex) { frames[frameIndex].names.clear(); }
+		// Zones may nest and may be inside render passes. Zones past MAX_ZONES are dropped
+		uint32_t BeginZone(VkCommandBuffer commandBuffer, const char* name);
+		void EndZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+		bool IsSupported() const { return queryPool != VK_NULL_HANDLE; }
+		// Zones of the latest frame read back, in the order they began
+		const std::vector<Zone>& GetResults() const { return results; }
+		// frameNumber passed to the BeginFrame that recorded the results
+		uint64_t GetResultsFrameNumber() const { return resultsFrameNumber; }
+
+	private:
+		static constexpr uint32_t QUERIES_PER_FRAME = MAX_ZONES * 2;
+
+		struct FrameZones {
+			std::vector<const char*> names;
+			uint64_t frameNumber = 0;
+		};
+
+		bool readResults(int frameIndex);
+
+		EngineDevice& engineDevice;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		// Nanoseconds per timestamp tick
+		double timestampPeriod = 1.0;
+
+		FrameZones frames[EngineSwapChain::MAX_FRAMES_IN_FLIGHT];
+		int currentFrameIndex = 0;
+		std::vector<Zone> results;
+		uint64_t resultsFrameNumber = 0;
+		std::vector<uint64_t> timestamps;
+	};
+}
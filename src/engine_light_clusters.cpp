@@ -0,0 +1,144 @@
+#include "engine_light_clusters.hpp"
+#include "engine_swap_chain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace Engine {
+
+	static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 64;
+	static constexpr uint32_t INITIAL_INDEX_CAPACITY = 1024;
+
+	EngineLightClusters::EngineLightClusters(
+		EngineDevice& device,
+		EngineDescriptorSetLayout& lightSetLayout,
+		EngineDescriptorAllocator& allocator)
+		: engineDevice(device), lightSetLayout(lightSetLayout), descriptorAllocator(allocator) {
+		clusterRanges.resize(CLUSTER_COUNT);
+
+		frames.resize(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames) {
+			reserveStorage(frame.lightBuffer, sizeof(PointLight), INITIAL_LIGHT_CAPACITY);
+			reserveStorage(frame.clusterBuffer, sizeof(glm::uvec2), CLUSTER_COUNT);
+			reserveStorage(frame.indexBuffer, sizeof(uint32_t), INITIAL_INDEX_CAPACITY);
+			writeDescriptorSet(frame);
+		}
+	}
+
+	void EngineLightClusters::Update(int frameIndex, const EngineCamera& camera, const std::vector<PointLight>& lights) {
+		binLights(camera, lights);
+		lightCount = static_cast<uint32_t>(lights.size());
+
+		auto& frame = frames[frameIndex];
+		bool grown = reserveStorage(frame.lightBuffer, sizeof(PointLight), static_cast<uint32_t>(lights.size()));
+		grown |= reserveStorage(frame.indexBuffer, sizeof(uint32_t), static_cast<uint32_t>(lightIndices.size()));
+		if (grown) {
+			writeDescriptorSet(frame);
+		}
+
+		if (!lights.empty()) {
+			frame.lightBuffer->writeToBuffer((void*)lights.data(), lights.size() * sizeof(PointLight));
+			frame.lightBuffer->flush();
+		}
+		frame.clusterBuffer->writeToBuffer(clusterRanges.data(), clusterRanges.size() * sizeof(glm::uvec2));
+		frame.clusterBuffer->flush();
+		if (!lightIndices.empty()) {
+			frame.indexBuffer->writeToBuffer(lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+			frame.indexBuffer->flush();
+		}
+	}
+
+	void EngineLightClusters::binLights(const EngineCamera& camera, const std::vector<PointLight>& lights) {
+		const glm::mat4& view = camera.GetView();
+		const glm::mat4& projection = camera.GetProjection();
+		const float zNear = camera.GetNear();
+		const float zFar = camera.GetFar();
+		// Slice of a view depth, must match the fragment shader
+		const float sliceScale = CLUSTER_Z / std::log(zFar / zNear);
+		auto sliceOf = [&](float depth) {
+			float slice = std::floor(std::log(depth / zNear) * sliceScale);
+			return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(CLUSTER_Z - 1)));
+		};
+		auto tileOf = [](float ndc, uint32_t tileCount) {
+			float tile = std::floor((ndc * 0.5f + 0.5f) * tileCount);
+			return static_cast<uint32_t>(std::clamp(tile, 0.0f, static_cast<float>(tileCount - 1)));
+		};
+
+		// First pass: cluster range of every visible light and the light count per cluster
+		lightBounds.clear();
+		std::fill(clusterRanges.begin(), clusterRanges.end(), glm::uvec2{ 0 });
+		for (uint32_t i = 0; i < lights.size(); i++) {
+			glm::vec3 center{ view * glm::vec4(glm::vec3(lights[i].position), 1.0f) };
+			float radius = lights[i].position.w;
+			if (center.z + radius <= zNear || center.z - radius >= zFar)
+				continue;
+
+			// Project the light's view space bounding box, clipped to the depth range, onto the screen
+			float minDepth = std::max(center.z - radius, zNear);
+			float maxDepth = std::min(center.z + radius, zFar);
+			glm::vec2 ndcMin{ std::numeric_limits<float>::max() };
+			glm::vec2 ndcMax{ -std::numeric_limits<float>::max() };
+			for (int corner = 0; corner < 8; corner++) {
+				glm::vec4 clip = projection * glm::vec4(
+					center.x + ((corner & 1) ? radius : -radius),
+					center.y + ((corner & 2) ? radius : -radius),
+					(corner & 4) ? maxDepth : minDepth,
+					1.0f);
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+			if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+				continue;
+
+			LightBounds bounds{
+				i,
+				tileOf(ndcMin.x, CLUSTER_X), tileOf(ndcMax.x, CLUSTER_X),
+				tileOf(ndcMin.y, CLUSTER_Y), tileOf(ndcMax.y, CLUSTER_Y),
+				sliceOf(minDepth), sliceOf(maxDepth)
+			};
+			for (uint32_t z = bounds.minZ; z <= bounds.maxZ; z++)
+				for (uint32_t y = bounds.minY; y <= bounds.maxY; y++)
+					for (uint32_t x = bounds.minX; x <= bounds.maxX; x++)
+						clusterRanges[x + CLUSTER_X * (y + CLUSTER_Y * z)].y++;
+			lightBounds.push_back(bounds);
+		}
+
+		// Prefix sum into offsets, then fill the index list using the counts as cursors
+		uint32_t total = 0;
+		for (auto& range : clusterRanges) {
+			range.x = total;
+			total += range.y;
+			range.y = 0;
+		}
+		lightIndices.resize(total);
+		for (auto& bounds : lightBounds) {
+			for (uint32_t z = bounds.minZ; z <= bounds.maxZ; z++)
+				for (uint32_t y = bounds.minY; y <= bounds.maxY; y++)
+					for (uint32_t x = bounds.minX; x <= bounds.maxX; x++) {
+						auto& range = clusterRanges[x + CLUSTER_X * (y + CLUSTER_Y * z)];
+						lightIndices[range.x + range.y++] = bounds.lightIndex;
+					}
+		}
+	}
+
+	void EngineLightClusters::writeDescriptorSet(FrameResources& frame) {
+		auto lightInfo = frame.lightBuffer->descriptorInfo();
+		auto clusterInfo = frame.clusterBuffer->descriptorInfo();
+		auto indexInfo = frame.indexBuffer->descriptorInfo();
+		EngineDescriptorWriter writer{ lightSetLayout, descriptorAllocator };
+		writer.writeBuffer(0, &lightInfo)
+			.writeBuffer(1, &clusterInfo)
+			.writeBuffer(2, &indexInfo);
+
+		if (frame.descriptorSet == VK_NULL_HANDLE) {
+			if (!writer.build(frame.descriptorSet))
+				throw std::runtime_error("Failed to allocate light cluster descriptor set");
+		}
+		else {
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_buffer.hpp"
+#include "engine_camera.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_frame_info.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Engine {
+
+	// Bins point lights into a view space cluster grid on the CPU and uploads the lists per frame.
+	// The grid is CLUSTER_X * CLUSTER_Y screen tiles with CLUSTER_Z exponential depth slices
+	// between the camera planes, so a fragment only iterates the lights that reach its cluster.
+	// Buffers grow with the light count, there is no upper limit on lights
+	class EngineLightClusters {
+	public:
+		static constexpr uint32_t CLUSTER_X = 16;
+		static constexpr uint32_t CLUSTER_Y = 16;
+		static constexpr uint32_t CLUSTER_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+		// lightSetLayout must hold the light, cluster range and light index storage buffers at bindings 0-2
+		EngineLightClusters(EngineDevice& device, EngineDescriptorSetLayout& lightSetLayout, EngineDescriptorAllocator& allocator);
+
+		EngineLightClusters(const EngineLightClusters&) = delete;
+		EngineLightClusters& operator=(const EngineLightClusters&) = delete;
+
+		// Rebuilds the clusters of a frame slot, the frame last recorded in it must have finished
+		void Update(int frameIndex, const EngineCamera& camera, const std::vector<PointLight>& lights);
+
+		VkDescriptorSet GetDescriptorSet(int frameIndex) const { return frames[frameIndex].descriptorSet; }
+		uint32_t GetLightCount() const { return lightCount; }
+		// Sum of lights over all clusters after the last Update
+		uint32_t GetLightReferenceCount() const { return static_cast<uint32_t>(lightIndices.size()); }
+
+	private:
+		struct FrameResources {
+			std::unique_ptr<EngineBuffer> lightBuffer;
+			std::unique_ptr<EngineBuffer> clusterBuffer;
+			std::unique_ptr<EngineBuffer> indexBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		// Inclusive cluster ranges touched by one light
+		struct LightBounds {
+			uint32_t lightIndex;
+			uint32_t minX, maxX, minY, maxY, minZ, maxZ;
+		};
+
+		bool reserveStorage(std::unique_ptr<EngineBuffer>& buffer, VkDeviceSize instanceSize, uint32_t count) {
+			return EngineBuffer::reserveMapped(engineDevice, buffer, instanceSize, count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		}
+		void writeDescriptorSet(FrameResources& frame);
+		void binLights(const EngineCamera& camera, const std::vector<PointLight>& lights);
+
+		EngineDevice& engineDevice;
+		EngineDescriptorSetLayout& lightSetLayout;
+		EngineDescriptorAllocator& descriptorAllocator;
+		std::vector<FrameResources> frames;
+
+		// Scratch kept between frames to avoid reallocating
+		std::vector<LightBounds> lightBounds;
+		std::vector<glm::uvec2> clusterRanges; // offset, count into lightIndices
+		std::vector<uint32_t> lightIndices;
+		uint32_t lightCount = 0;
+	};
+}
@@ -1,5 +1,6 @@
 #include "engine_model.hpp"
 #include "engine_utils.hpp"
+#include "engine_profiler.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -37,6 +38,7 @@ namespace Engine {
 	EngineModel::~EngineModel() {}
 	
 	std::unique_ptr<EngineModel> EngineModel::CreateModelFromFile(EngineDevice& device, const std::string& filePath) {
+		ENGINE_PROFILE_ZONE("Load model");
 		Builder builder{};
 		builder.LoadModel(ENGINE_DIR + filePath);
 		std::cout << "Vertex count: " << builder.vertices.size() << '\n';
@@ -61,6 +63,25 @@ namespace Engine {
 			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 		}
 	}
+
+	void EngineModel::Bind(EngineCommandRecorder& recorder) {
+		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		recorder.BindVertexBuffers(0, 1, buffers, offsets);
+
+		if (hasIndexBuffer) {
+			recorder.BindIndexBuffer(indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		}
+	}
+
+	void EngineModel::Draw(EngineCommandRecorder& recorder, uint32_t instanceCount, uint32_t firstInstance) {
+		if (hasIndexBuffer) {
+			recorder.DrawIndexed(indexCount, instanceCount, 0, 0, firstInstance);
+		}
+		else {
+			recorder.Draw(vertexCount, instanceCount, 0, firstInstance);
+		}
+	}
 	
 	void EngineModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
 		vertexCount = static_cast<uint32_t>(vertices.size());
@@ -147,6 +168,7 @@ namespace Engine {
 	}
 
 	void EngineModel::Builder::LoadModel(const std::string& filePath) {
+		ENGINE_PROFILE_ZONE("Parse OBJ");
 		tinyobj::attrib_t attrib; // Position Color Normal Texture Coordinates Data
 		std::vector<tinyobj::shape_t> shapes; // Index Values
 		std::vector<tinyobj::material_t> materials; // Material
@@ -2,6 +2,7 @@
 
 #include "engine_device.hpp"
 #include "engine_buffer.hpp"
+#include "engine_command_recorder.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -47,6 +48,8 @@ namespace Engine {
 
 		void Bind(VkCommandBuffer commandBuffer);
 		void Draw(VkCommandBuffer commandBuffer);
+		void Bind(EngineCommandRecorder& recorder);
+		void Draw(EngineCommandRecorder& recorder, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
 	private:
 
@@ -0,0 +1,73 @@
+#include "engine_object_buffer.hpp"
+#include "engine_swap_chain.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Engine {
+
+	static constexpr uint32_t INITIAL_OBJECT_CAPACITY = 256;
+
+	EngineObjectBuffer::EngineObjectBuffer(
+		EngineDevice& device,
+		EngineDescriptorSetLayout& objectSetLayout,
+		EngineDescriptorAllocator& allocator)
+		: engineDevice(device), objectSetLayout(objectSetLayout), descriptorAllocator(allocator) {
+		frames.resize(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames) {
+			EngineBuffer::reserveMapped(
+				engineDevice, frame.objectBuffer, sizeof(ObjectData), INITIAL_OBJECT_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			writeDescriptorSet(frame);
+		}
+	}
+
+	void EngineObjectBuffer::Update(int frameIndex, EngineGameObject::Map& gameObjects) {
+		objectCount = 0;
+		for (auto& kv : gameObjects) {
+			if (kv.second.model != nullptr)
+				objectCount++;
+		}
+
+		auto& frame = frames[frameIndex];
+		if (EngineBuffer::reserveMapped(
+			engineDevice, frame.objectBuffer, sizeof(ObjectData), objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) {
+			writeDescriptorSet(frame);
+		}
+
+		std::fill(objectIndices.begin(), objectIndices.end(), INVALID_INDEX);
+		auto* objects = static_cast<ObjectData*>(frame.objectBuffer->getMappedMemory());
+		uint32_t index = 0;
+		for (auto& kv : gameObjects) {
+			auto& obj = kv.second;
+			if (obj.model == nullptr)
+				continue;
+
+			if (obj.GetId() >= objectIndices.size())
+				objectIndices.resize(obj.GetId() + 1, INVALID_INDEX);
+			objectIndices[obj.GetId()] = index;
+
+			// glm is column major, the shader gets the first three rows
+			glm::mat4 model = obj.transform.mat4();
+			ObjectData& data = objects[index++];
+			for (int row = 0; row < 3; row++)
+				data.modelRows[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+		}
+		if (objectCount > 0) {
+			frame.objectBuffer->flush();
+		}
+	}
+
+	void EngineObjectBuffer::writeDescriptorSet(FrameResources& frame) {
+		auto bufferInfo = frame.objectBuffer->descriptorInfo();
+		EngineDescriptorWriter writer{ objectSetLayout, descriptorAllocator };
+		writer.writeBuffer(0, &bufferInfo);
+
+		if (frame.descriptorSet == VK_NULL_HANDLE) {
+			if (!writer.build(frame.descriptorSet))
+				throw std::runtime_error("Failed to allocate object descriptor set");
+		}
+		else {
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+}
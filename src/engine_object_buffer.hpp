@@ -0,0 +1,63 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_buffer.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_game_object.hpp"
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+namespace Engine {
+
+	// std430 element of the object storage buffer. Rows of the affine model matrix, the shaders
+	// rebuild the normal matrix from it instead of receiving a second matrix
+	struct ObjectData {
+		glm::vec4 modelRows[3]{};
+	};
+
+	// Per-frame storage buffer with the transform of every game object that has a model.
+	// Draws select their object through firstInstance, the vertex shader reads
+	// objects[gl_InstanceIndex], so a run of objects can be drawn with one instanced draw.
+	// Grows with the object count like the light cluster buffers
+	class EngineObjectBuffer {
+	public:
+		// objectSetLayout must hold the object storage buffer at binding 0
+		EngineObjectBuffer(EngineDevice& device, EngineDescriptorSetLayout& objectSetLayout, EngineDescriptorAllocator& allocator);
+
+		EngineObjectBuffer(const EngineObjectBuffer&) = delete;
+		EngineObjectBuffer& operator=(const EngineObjectBuffer&) = delete;
+
+		// Writes the frame slot's buffer, the frame last recorded in it must have finished
+		void Update(int frameIndex, EngineGameObject::Map& gameObjects);
+
+		VkDescriptorSet GetDescriptorSet(int frameIndex) const { return frames[frameIndex].descriptorSet; }
+		uint32_t GetObjectCount() const { return objectCount; }
+		// Index of the object's transform after the last Update, the draw's firstInstance
+		uint32_t GetObjectIndex(EngineGameObject::id_t id) const {
+			assert(id < objectIndices.size() && objectIndices[id] != INVALID_INDEX && "Object has no transform in the object buffer");
+			return objectIndices[id];
+		}
+
+	private:
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		struct FrameResources {
+			std::unique_ptr<EngineBuffer> objectBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		void writeDescriptorSet(FrameResources& frame);
+
+		EngineDevice& engineDevice;
+		EngineDescriptorSetLayout& objectSetLayout;
+		EngineDescriptorAllocator& descriptorAllocator;
+		std::vector<FrameResources> frames;
+
+		// Indexed by game object id, ids are handed out sequentially
+		std::vector<uint32_t> objectIndices;
+		uint32_t objectCount = 0;
+	};
+}
@@ -2,85 +2,80 @@
 
 #include "engine_model.hpp"
 
-#include <fstream>
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
 
-#ifndef ENGINE_DIR
-#define ENGINE_DIR "../"
-#endif
-
 namespace Engine {
 
 	EnginePipeline::EnginePipeline(
 		EngineDevice& device, 
-		const std::string& vertFilePath, 
-		const std::string& fragFilePath,
-		const PipelineConfigInfo& configInfo) : engineDevice(device){
+		std::shared_ptr<EngineShaderModule> vertShader,
+		std::shared_ptr<EngineShaderModule> fragShader,
+		const PipelineConfigInfo& configInfo,
+		VkPipelineCache pipelineCache) 
+		: engineDevice(device), vertShaderModule(std::move(vertShader)), fragShaderModule(std::move(fragShader)) {
 
-		createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
+		createGraphicsPipeline(configInfo, pipelineCache);
 	}
 
+	EnginePipeline::EnginePipeline(
+		EngineDevice& device, 
+		EngineShaderLibrary& shaderLibrary,
+		const std::string& vertFilePath, 
+		const std::string& fragFilePath,
+		const PipelineConfigInfo& configInfo,
+		VkPipelineCache pipelineCache) 
+		: EnginePipeline(
+			device, 
+			shaderLibrary.Acquire(vertFilePath), 
+			shaderLibrary.Acquire(fragFilePath), 
+			configInfo, 
+			pipelineCache) {}
+
 	EnginePipeline::~EnginePipeline() {
-		vkDestroyShaderModule(engineDevice.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(engineDevice.device(), fragShaderModule, nullptr);
-		vkDestroyPipeline(engineDevice.device(), graphicsPipeline, nullptr);
+		// Frames in flight may still draw with it
+		engineDevice.deletionQueue().DestroyPipeline(graphicsPipeline);
 	}
 
 	void EnginePipeline::Bind(VkCommandBuffer commandBuffer) {
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
-	std::vector<char> EnginePipeline::readFile(const std::string& filePath) {
-		std::string enginePath = ENGINE_DIR + filePath;
-		std::ifstream file{ enginePath, std::ios::ate | std::ios::binary };
-
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to open file: " + enginePath);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-
-		std::vector<char> buffer(fileSize);
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
-
-		return buffer;
+	void EnginePipeline::Bind(EngineCommandRecorder& recorder) {
+		recorder.BindPipeline(graphicsPipeline);
 	}
 
-	void EnginePipeline::createGraphicsPipeline(
-		const std::string& vertFilePath, 
-		const std::string& fragFilePath, 
-		const PipelineConfigInfo& configInfo) {
+	void EnginePipeline::createGraphicsPipeline(const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache) {
 
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipeline provided in layoutInfo");
 		assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in layoutInfo");
 
-		auto vertCode = readFile(vertFilePath);
-		auto fragCode = readFile(fragFilePath);
-		
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationEntries.size());
+		specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+		specializationInfo.dataSize = configInfo.specializationData.size();
+		specializationInfo.pData = configInfo.specializationData.data();
+		const VkSpecializationInfo* pSpecializationInfo = 
+			configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = vertShaderModule->GetShaderModule();
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = fragShaderModule->GetShaderModule();
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 		// Describe how to interpret vertex buffer data info the graphics pipeline
 		auto& bindingDescriptions = configInfo.bindingDescriptions;
@@ -116,7 +111,7 @@ namespace Engine {
 
 		if (vkCreateGraphicsPipelines(
 			engineDevice.device(),
-			VK_NULL_HANDLE, 
+			pipelineCache, 
 			1, 
 			&pipelineInfo, 
 			nullptr, 
@@ -126,19 +121,6 @@ namespace Engine {
 		}
 
 	}
-	void EnginePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-	
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(engineDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create shader module");
-		}
-
-	}
-
 	void EnginePipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 
 		// Telling Vulkan how to take in Vertex data and construct them
@@ -234,4 +216,26 @@ namespace Engine {
 		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;             
 	}
 
+	void EnginePipeline::EnableAdditiveBlending(PipelineConfigInfo& configInfo) {
+		// Accumulates light contributions, dst = src + dst
+		configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+
+		configInfo.colorBlendAttachment.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+			VK_COLOR_COMPONENT_A_BIT;
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
+	void EnginePipeline::SetColorAttachmentCount(PipelineConfigInfo& configInfo, uint32_t count) {
+		// Every attachment copies the current blend state
+		configInfo.colorBlendAttachments.assign(count, configInfo.colorBlendAttachment);
+		configInfo.colorBlendInfo.attachmentCount = count;
+		configInfo.colorBlendInfo.pAttachments = configInfo.colorBlendAttachments.data();
+	}
+
 }
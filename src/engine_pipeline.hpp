@@ -1,7 +1,12 @@
 #pragma once
 
 #include "engine_device.hpp"
+#include "engine_shader_library.hpp"
+#include "engine_command_recorder.hpp"
 
+#include <cassert>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -20,6 +25,8 @@ namespace Engine {
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
 		VkPipelineMultisampleStateCreateInfo multisampleInfo;
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
+		// Multiple render targets, see EnginePipeline::SetColorAttachmentCount
+		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{};
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
@@ -27,6 +34,10 @@ namespace Engine {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+
+		// Shared by every stage, constant ids a stage doesn't declare are ignored by Vulkan
+		std::vector<VkSpecializationMapEntry> specializationEntries{};
+		std::vector<uint8_t> specializationData{};
 	};
 
 	class EnginePipeline {
@@ -35,31 +46,58 @@ namespace Engine {
 		EnginePipeline() = default;
 		EnginePipeline(
 			EngineDevice& device,
+			std::shared_ptr<EngineShaderModule> vertShader,
+			std::shared_ptr<EngineShaderModule> fragShader,
+			const PipelineConfigInfo& configInfo,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		EnginePipeline(
+			EngineDevice& device,
+			EngineShaderLibrary& shaderLibrary,
 			const std::string& vertFilePath, 
 			const std::string& fragFilePath, 
-			const PipelineConfigInfo& configInfo);
+			const PipelineConfigInfo& configInfo,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE);
 		~EnginePipeline();
 
 		EnginePipeline(const EnginePipeline&) = delete;
 		EnginePipeline& operator=(const EnginePipeline&) = delete;
 
 		void Bind(VkCommandBuffer commandBuffer);
+		void Bind(EngineCommandRecorder& recorder);
 		static void DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void EnableAlphaBlending(PipelineConfigInfo& configInfo);
+		static void EnableAdditiveBlending(PipelineConfigInfo& configInfo);
+		// Call after setting up blending, the subpass writes count color attachments
+		static void SetColorAttachmentCount(PipelineConfigInfo& configInfo, uint32_t count);
 
-	private:
-		static std::vector<char> readFile(const std::string& filePath);
+		// Bakes a value into the shaders' layout(constant_id = ...) declarations.
+		// Use uint32_t (VkBool32) for bool constants
+		template <typename T>
+		static void SetSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, T value) {
+			static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Specialization constants must be 32 or 64 bit scalars");
+			for (auto& entry : configInfo.specializationEntries) {
+				if (entry.constantID == constantId) {
+					assert(entry.size == sizeof(T) && "Specialization constant redefined with a different size");
+					std::memcpy(configInfo.specializationData.data() + entry.offset, &value, sizeof(T));
+					return;
+				}
+			}
+			VkSpecializationMapEntry entry{};
+			entry.constantID = constantId;
+			entry.offset = static_cast<uint32_t>(configInfo.specializationData.size());
+			entry.size = sizeof(T);
+			configInfo.specializationEntries.push_back(entry);
+			configInfo.specializationData.resize(entry.offset + sizeof(T));
+			std::memcpy(configInfo.specializationData.data() + entry.offset, &value, sizeof(T));
+		}
 
-		void createGraphicsPipeline(
-			const std::string& vertFilePath, 
-			const std::string& fragFilePath,
-			const PipelineConfigInfo& configInfo);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+	private:
+		void createGraphicsPipeline(const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache);
 
 		EngineDevice& engineDevice;
 		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		// Shared with other pipelines through the shader library
+		std::shared_ptr<EngineShaderModule> vertShaderModule;
+		std::shared_ptr<EngineShaderModule> fragShaderModule;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "engine_pipeline_compiler.hpp"
+#include "engine_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine {
+
+	bool EnginePipelineHandle::IsReady() const {
+		return job != nullptr &&
+			job->pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void EnginePipelineHandle::Wait() const {
+		assert(job != nullptr && "Cannot wait on an empty pipeline handle");
+		job->pipeline.wait();
+	}
+
+	EnginePipeline* EnginePipelineHandle::Get() const {
+		if (job == nullptr)
+			return nullptr;
+		if (IsReady() && !job->failed) {
+			try {
+				return job->pipeline.get().get();
+			}
+			catch (const std::exception& e) {
+				// Reported once, the fallback draws from now on until a reload fixes the shader
+				std::cerr << "Pipeline compile failed for " << job->vertFilePath << " / " << job->fragFilePath
+					<< ": " << e.what() << std::endl;
+				job->failed = true;
+			}
+		}
+		return job->fallback.Get();
+	}
+
+	bool EnginePipelineHandle::Bind(VkCommandBuffer commandBuffer) const {
+		auto pipeline = Get();
+		if (pipeline == nullptr)
+			return false;
+		pipeline->Bind(commandBuffer);
+		return true;
+	}
+
+	bool EnginePipelineHandle::Bind(EngineCommandRecorder& recorder) const {
+		auto pipeline = Get();
+		if (pipeline == nullptr)
+			return false;
+		pipeline->Bind(recorder);
+		return true;
+	}
+
+	EnginePipelineCompiler::EnginePipelineCompiler(EngineDevice& device, EngineShaderLibrary& library, uint32_t workerCount)
+		: engineDevice(device), shaderLibrary(library) {
+		createPipelineCache();
+
+		if (workerCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+		}
+		for (uint32_t i = 0; i < workerCount; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	EnginePipelineCompiler::~EnginePipelineCompiler() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+
+		compiledJobs.clear();
+		vkDestroyPipelineCache(engineDevice.device(), pipelineCache, nullptr);
+	}
+
+	void EnginePipelineCompiler::createPipelineCache() {
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(engineDevice.device(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	EnginePipelineHandle EnginePipelineCompiler::Compile(
+		const std::string& vertFilePath,
+		const std::string& fragFilePath,
+		std::unique_ptr<PipelineConfigInfo> configInfo,
+		EnginePipelineHandle fallback) {
+		assert(configInfo != nullptr && "Cannot compile a pipeline without a config");
+
+		auto job = std::make_shared<PipelineCompileJob>();
+		job->vertFilePath = vertFilePath;
+		job->fragFilePath = fragFilePath;
+		job->configInfo = std::move(configInfo);
+		job->fallback = std::move(fallback);
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			compiledJobs.push_back(job);
+		}
+		job->pipeline = enqueue(job.get());
+
+		return EnginePipelineHandle{ job };
+	}
+
+	std::shared_future<std::shared_ptr<EnginePipeline>> EnginePipelineCompiler::enqueue(PipelineCompileJob* job) {
+		// The task only borrows the job, the compiler owns it through compiledJobs
+		auto task = std::make_shared<std::packaged_task<std::shared_ptr<EnginePipeline>()>>(
+			[this, job]() {
+				return std::make_shared<EnginePipeline>(
+					engineDevice,
+					shaderLibrary,
+					job->vertFilePath,
+					job->fragFilePath,
+					*job->configInfo,
+					pipelineCache);
+			});
+		auto future = task->get_future().share();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.emplace_back([task]() { (*task)(); });
+			pendingJobs++;
+		}
+		queueCondition.notify_one();
+		return future;
+	}
+
+	size_t EnginePipelineCompiler::ReloadShader(const std::string& shaderFilePath) {
+		shaderLibrary.Invalidate(shaderFilePath);
+
+		std::vector<PipelineCompileJob*> affected;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (auto& job : compiledJobs) {
+				if (job->vertFilePath == shaderFilePath || job->fragFilePath == shaderFilePath)
+					affected.push_back(job.get());
+			}
+		}
+
+		// A newer reload simply replaces one that hasn't been committed yet
+		for (auto job : affected) {
+			job->reload = enqueue(job);
+		}
+		std::cout << "Reloading " << shaderFilePath << ": " << affected.size() << " pipeline(s)" << std::endl;
+		return affected.size();
+	}
+
+	void EnginePipelineCompiler::CommitReloads() {
+		std::vector<PipelineCompileJob*> jobs;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (auto& job : compiledJobs)
+				jobs.push_back(job.get());
+		}
+
+		for (auto job : jobs) {
+			if (!job->reload.valid() || job->reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				continue;
+
+			auto reload = std::move(job->reload);
+			job->reload = {};
+			try {
+				reload.get();
+			}
+			catch (const std::exception& e) {
+				// Keep drawing with the old pipeline until the shader is fixed
+				std::cerr << "Shader reload failed for " << job->vertFilePath << " / " << job->fragFilePath
+					<< ": " << e.what() << std::endl;
+				continue;
+			}
+
+			// The replaced pipeline's VkPipeline goes through the deletion queue, frames in flight keep it
+			job->pipeline = std::move(reload);
+			job->failed = false;
+		}
+	}
+
+	void EnginePipelineCompiler::WaitIdle() {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		idleCondition.wait(lock, [this]() { return pendingJobs == 0; });
+	}
+
+	void EnginePipelineCompiler::workerLoop() {
+		ENGINE_PROFILE_THREAD_NAME("Pipeline compiler");
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+				// Drain whatever is left before exiting so no handle is left with a broken promise
+				if (queue.empty())
+					return;
+				task = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			{
+				ENGINE_PROFILE_ZONE("Compile pipeline");
+				task();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				pendingJobs--;
+			}
+			idleCondition.notify_all();
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_pipeline.hpp"
+#include "engine_shader_library.hpp"
+#include "engine_swap_chain.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine {
+
+	struct PipelineCompileJob;
+
+	// Reference to a pipeline that may still be compiling on a worker thread
+	class EnginePipelineHandle {
+	public:
+		EnginePipelineHandle() = default;
+
+		bool IsValid() const { return job != nullptr; }
+		bool IsReady() const;
+		void Wait() const;
+
+		// Compiled pipeline, or the fallback's pipeline while this one is still compiling or after it
+		// failed to compile. Returns nullptr when neither is available
+		EnginePipeline* Get() const;
+		bool Bind(VkCommandBuffer commandBuffer) const;
+		bool Bind(EngineCommandRecorder& recorder) const;
+
+	private:
+		friend class EnginePipelineCompiler;
+		explicit EnginePipelineHandle(std::shared_ptr<PipelineCompileJob> job) : job(std::move(job)) {}
+
+		std::shared_ptr<PipelineCompileJob> job;
+	};
+
+	struct PipelineCompileJob {
+		std::string vertFilePath;
+		std::string fragFilePath;
+		// Heap allocated so the internal pointers of the config stay valid while it is queued
+		std::unique_ptr<PipelineConfigInfo> configInfo;
+		std::shared_future<std::shared_ptr<EnginePipeline>> pipeline;
+		// Rebuild queued by a shader reload, swapped into pipeline by CommitReloads
+		std::shared_future<std::shared_ptr<EnginePipeline>> reload;
+		EnginePipelineHandle fallback;
+		// Set once the failure of pipeline was logged, cleared when a reload replaces it
+		bool failed = false;
+	};
+
+	// Builds pipelines concurrently on worker threads, all sharing one VkPipelineCache.
+	// Compile, ReloadShader and CommitReloads are meant to be called from the render thread
+	class EnginePipelineCompiler {
+	public:
+		// workerCount of 0 uses one worker per hardware thread, minus the main thread
+		EnginePipelineCompiler(EngineDevice& device, EngineShaderLibrary& shaderLibrary, uint32_t workerCount = 0);
+		~EnginePipelineCompiler();
+
+		EnginePipelineCompiler(const EnginePipelineCompiler&) = delete;
+		EnginePipelineCompiler& operator=(const EnginePipelineCompiler&) = delete;
+
+		EnginePipelineHandle Compile(
+			const std::string& vertFilePath,
+			const std::string& fragFilePath,
+			std::unique_ptr<PipelineConfigInfo> configInfo,
+			EnginePipelineHandle fallback = {});
+
+		// Blocks until every submitted pipeline has finished compiling
+		void WaitIdle();
+
+		// Invalidates the shader and rebuilds every pipeline using it in the background.
+		// Returns the number of pipelines queued
+		size_t ReloadShader(const std::string& shaderFilePath);
+
+		// Call once per frame, before BeginFrame. Swaps finished rebuilds in, replaced pipelines are
+		// destroyed through the device's deletion queue once no submitted frame can use them
+		void CommitReloads();
+
+		VkPipelineCache GetPipelineCache() const { return pipelineCache; }
+		uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		void createPipelineCache();
+		void workerLoop();
+		std::shared_future<std::shared_ptr<EnginePipeline>> enqueue(PipelineCompileJob* job);
+
+		EngineDevice& engineDevice;
+		EngineShaderLibrary& shaderLibrary;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> queue;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::condition_variable idleCondition;
+		size_t pendingJobs = 0;
+		bool stopping = false;
+
+		// Keeps every compiled pipeline alive for the lifetime of the compiler
+		std::vector<std::shared_ptr<PipelineCompileJob>> compiledJobs;
+	};
+}
@@ -0,0 +1,202 @@
+#include "engine_pipeline_layout_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace Engine {
+
+	template <typename T>
+	static void appendKey(std::string& key, const T& value) {
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		key.append(bytes, sizeof(T));
+	}
+
+	bool PipelineLayoutInfo::MatchesVertexInput(
+		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const {
+		for (auto& input : vertexInputs) {
+			auto attribute = std::find_if(attributeDescriptions.begin(), attributeDescriptions.end(),
+				[&](const VkVertexInputAttributeDescription& description) { return description.location == input.location; });
+			if (attribute == attributeDescriptions.end() || attribute->format != input.format)
+				return false;
+		}
+		return true;
+	}
+
+	EnginePipelineLayoutCache::EnginePipelineLayoutCache(EngineDevice& device, EngineShaderLibrary& shaderLibrary)
+		: engineDevice(device), shaderLibrary(shaderLibrary) {
+	}
+
+	EnginePipelineLayoutCache::~EnginePipelineLayoutCache() {
+		for (auto& kv : pipelineLayouts)
+			vkDestroyPipelineLayout(engineDevice.device(), kv.second, nullptr);
+	}
+
+	void EnginePipelineLayoutCache::SetDescriptorTypeOverride(uint32_t set, uint32_t binding, VkDescriptorType descriptorType) {
+		assert(shaderLayouts.empty() && "Descriptor type overrides must be set before any layout is built");
+		assert((descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+			descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) &&
+			"Only dynamic buffers can override a reflected descriptor type");
+		descriptorTypeOverrides[static_cast<uint64_t>(set) << 32 | binding] = descriptorType;
+	}
+
+	void EnginePipelineLayoutCache::SetExternalSetLayout(uint32_t set, EngineDescriptorSetLayout& setLayout) {
+		assert(shaderLayouts.empty() && "External set layouts must be set before any layout is built");
+		externalSetLayouts[set] = &setLayout;
+	}
+
+	const PipelineLayoutInfo& EnginePipelineLayoutCache::GetLayout(
+		const std::string& vertFilePath,
+		const std::string& fragFilePath,
+		uint32_t pushDescriptorSet) {
+		std::string shaderKey = vertFilePath + '\n' + fragFilePath;
+		auto cached = shaderLayouts.find(shaderKey);
+		if (cached != shaderLayouts.end()) {
+			assert(cached->second.pushDescriptorSet == pushDescriptorSet && "Shader pair asked for with another push descriptor set");
+			return cached->second;
+		}
+
+		ShaderReflection stages[] = { shaderLibrary.Reflect(vertFilePath), shaderLibrary.Reflect(fragFilePath) };
+
+		// Merge the bindings of both stages per set
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+		PipelineLayoutInfo info{};
+		uint32_t pushConstantEnd = 0;
+		for (auto& stage : stages) {
+			for (auto reflected : stage.descriptorBindings) {
+				auto typeOverride = descriptorTypeOverrides.find(static_cast<uint64_t>(reflected.set) << 32 | reflected.binding);
+				if (typeOverride != descriptorTypeOverrides.end()) {
+					VkDescriptorType staticType = typeOverride->second == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ?
+						VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					if (reflected.descriptorType != staticType)
+						throw std::runtime_error("Descriptor type override doesn't match the shader in " + vertFilePath);
+					reflected.descriptorType = typeOverride->second;
+				}
+
+				auto& bindings = sets[reflected.set];
+				auto existing = bindings.find(reflected.binding);
+				if (existing != bindings.end()) {
+					if (existing->second.descriptorType != reflected.descriptorType ||
+						existing->second.descriptorCount != reflected.descriptorCount) {
+						throw std::runtime_error("Descriptor binding declared differently across stages in " + vertFilePath);
+					}
+					continue;
+				}
+				VkDescriptorSetLayoutBinding binding{};
+				binding.binding = reflected.binding;
+				binding.descriptorType = reflected.descriptorType;
+				binding.descriptorCount = reflected.descriptorCount;
+				binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+				bindings[reflected.binding] = binding;
+			}
+
+			if (stage.pushConstantSize > 0) {
+				// One range covering every stage, any push then updates the bytes all stages see
+				if (info.pushConstantStages == 0)
+					info.pushConstantOffset = stage.pushConstantOffset;
+				info.pushConstantOffset = std::min(info.pushConstantOffset, stage.pushConstantOffset);
+				pushConstantEnd = std::max(pushConstantEnd, stage.pushConstantOffset + stage.pushConstantSize);
+				info.pushConstantStages |= stage.stage;
+			}
+
+			if (stage.stage == VK_SHADER_STAGE_VERTEX_BIT)
+				info.vertexInputs = stage.vertexInputs;
+		}
+		info.pushConstantSize = pushConstantEnd - info.pushConstantOffset;
+		info.pushDescriptorSet = pushDescriptorSet;
+
+		std::vector<VkDescriptorSetLayout> setLayoutHandles;
+		uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+		for (uint32_t set = 0; set < setCount; set++) {
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+			for (auto& kv : sets[set])
+				bindings.push_back(kv.second);
+			auto external = externalSetLayouts.find(set);
+			assert((external == externalSetLayouts.end() || set != pushDescriptorSet) &&
+				"An external set layout can't become a push descriptor set");
+			auto& setLayout = external != externalSetLayouts.end() ? *external->second
+				: GetDescriptorSetLayout(bindings, set == pushDescriptorSet);
+			info.setLayouts.push_back(&setLayout);
+			setLayoutHandles.push_back(setLayout.getDescriptorSetLayout());
+		}
+
+		std::vector<VkPushConstantRange> pushConstantRanges;
+		if (info.pushConstantStages != 0) {
+			VkPushConstantRange range{};
+			range.stageFlags = info.pushConstantStages;
+			range.offset = info.pushConstantOffset;
+			range.size = info.pushConstantSize;
+			pushConstantRanges.push_back(range);
+		}
+		info.pipelineLayout = GetPipelineLayout(setLayoutHandles, pushConstantRanges);
+
+		return shaderLayouts.emplace(std::move(shaderKey), std::move(info)).first->second;
+	}
+
+	EngineDescriptorSetLayout& EnginePipelineLayoutCache::GetDescriptorSetLayout(
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		bool pushDescriptors) {
+		// Without device support a push descriptor set is a regular one, EngineDescriptorWriter::push falls back
+		VkDescriptorSetLayoutCreateFlags layoutFlags = pushDescriptors && engineDevice.supportsPushDescriptors() ?
+			VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+
+		std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+		std::sort(sorted.begin(), sorted.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+		std::string key;
+		appendKey(key, layoutFlags);
+		for (auto& binding : sorted) {
+			assert(binding.pImmutableSamplers == nullptr && "Immutable samplers are not part of the layout key");
+			appendKey(key, binding.binding);
+			appendKey(key, binding.descriptorType);
+			appendKey(key, binding.descriptorCount);
+			appendKey(key, binding.stageFlags);
+		}
+
+		auto cached = descriptorSetLayouts.find(key);
+		if (cached != descriptorSetLayouts.end())
+			return *cached->second;
+
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindingMap;
+		for (auto& binding : sorted)
+			bindingMap[binding.binding] = binding;
+		auto setLayout = std::make_unique<EngineDescriptorSetLayout>(engineDevice, bindingMap,
+			std::unordered_map<uint32_t, VkDescriptorBindingFlags>{}, layoutFlags);
+		auto& result = *setLayout;
+		descriptorSetLayouts.emplace(std::move(key), std::move(setLayout));
+		return result;
+	}
+
+	VkPipelineLayout EnginePipelineLayoutCache::GetPipelineLayout(
+		const std::vector<VkDescriptorSetLayout>& setLayouts,
+		const std::vector<VkPushConstantRange>& pushConstantRanges) {
+		std::string key;
+		appendKey(key, static_cast<uint32_t>(setLayouts.size()));
+		for (auto setLayout : setLayouts)
+			appendKey(key, setLayout);
+		for (auto& range : pushConstantRanges)
+			appendKey(key, range);
+
+		auto cached = pipelineLayouts.find(key);
+		if (cached != pipelineLayouts.end())
+			return cached->second;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout!");
+		}
+		pipelineLayouts.emplace(std::move(key), pipelineLayout);
+		return pipelineLayout;
+	}
+}
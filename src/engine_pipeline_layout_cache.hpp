@@ -0,0 +1,85 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_shader_library.hpp"
+#include "engine_shader_reflection.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+
+	// Layout of a vertex/fragment shader pair, every handle is owned by the cache
+	struct PipelineLayoutInfo {
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		// Indexed by set number, sets the shaders skip get an empty layout
+		std::vector<EngineDescriptorSetLayout*> setLayouts{};
+		// Stages to pass to vkCmdPushConstants, 0 when the shaders declare no push constants
+		VkShaderStageFlags pushConstantStages = 0;
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0;
+		// Set written with push descriptors, ~0u (NO_PUSH_DESCRIPTOR_SET) when there is none
+		uint32_t pushDescriptorSet = ~0u;
+		std::vector<ReflectedVertexInput> vertexInputs{};
+
+		// True if every input the vertex shader reads is fed with a matching format
+		bool MatchesVertexInput(const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const;
+	};
+
+	// Builds pipeline and descriptor set layouts from SPIR-V reflection instead of by hand, and
+	// deduplicates them: shader pairs declaring the same set share one VkDescriptorSetLayout.
+	// Descriptor stages are widened to ALL_GRAPHICS so a set reads the same from any shader pair.
+	// Layouts are reflected once per pair, hot reloaded shaders have to keep their interface.
+	// SPIR-V can't tell dynamic buffers apart, SetDescriptorTypeOverride marks them.
+	// Sets reflection can't describe at all, like the bindless table, are supplied with SetExternalSetLayout.
+	// A reflected set becomes a push descriptor set through GetLayout's pushDescriptorSet
+	class EnginePipelineLayoutCache {
+	public:
+		static constexpr uint32_t NO_PUSH_DESCRIPTOR_SET = ~0u;
+
+		EnginePipelineLayoutCache(EngineDevice& device, EngineShaderLibrary& shaderLibrary);
+		~EnginePipelineLayoutCache();
+
+		EnginePipelineLayoutCache(const EnginePipelineLayoutCache&) = delete;
+		EnginePipelineLayoutCache& operator=(const EnginePipelineLayoutCache&) = delete;
+
+		// Declares the buffer at set/binding as UNIFORM_BUFFER_DYNAMIC or STORAGE_BUFFER_DYNAMIC in every
+		// layout, call before the first GetLayout
+		void SetDescriptorTypeOverride(uint32_t set, uint32_t binding, VkDescriptorType descriptorType);
+
+		// Every shader declaring the set gets setLayout as is, its reflected bindings are ignored.
+		// The layout is owned by the caller and has to outlive the cache, call before the first GetLayout
+		void SetExternalSetLayout(uint32_t set, EngineDescriptorSetLayout& setLayout);
+
+		// pushDescriptorSet gets a push descriptor layout on devices that support them, write that set
+		// with EngineDescriptorWriter::push. A shader pair must always be asked for with the same value
+		const PipelineLayoutInfo& GetLayout(
+			const std::string& vertFilePath,
+			const std::string& fragFilePath,
+			uint32_t pushDescriptorSet = NO_PUSH_DESCRIPTOR_SET);
+
+		EngineDescriptorSetLayout& GetDescriptorSetLayout(
+			const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+			bool pushDescriptors = false);
+		VkPipelineLayout GetPipelineLayout(
+			const std::vector<VkDescriptorSetLayout>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+		size_t DescriptorSetLayoutCount() const { return descriptorSetLayouts.size(); }
+		size_t PipelineLayoutCount() const { return pipelineLayouts.size(); }
+
+	private:
+		EngineDevice& engineDevice;
+		EngineShaderLibrary& shaderLibrary;
+
+		std::unordered_map<std::string, std::unique_ptr<EngineDescriptorSetLayout>> descriptorSetLayouts;
+		std::unordered_map<std::string, VkPipelineLayout> pipelineLayouts;
+		std::unordered_map<std::string, PipelineLayoutInfo> shaderLayouts;
+		// Keyed by set << 32 | binding
+		std::unordered_map<uint64_t, VkDescriptorType> descriptorTypeOverrides;
+		std::unordered_map<uint32_t, EngineDescriptorSetLayout*> externalSetLayouts;
+	};
+}
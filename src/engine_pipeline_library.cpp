@@ -0,0 +1,149 @@
+#include "engine_pipeline_library.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+
+namespace Engine {
+
+	template <typename T>
+	static void appendKey(std::string& key, const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Pipeline key fields must be plain data");
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		key.append(bytes, sizeof(T));
+	}
+
+	static void appendKey(std::string& key, const std::string& value) {
+		appendKey(key, static_cast<uint32_t>(value.size()));
+		key.append(value);
+	}
+
+	// Vulkan structs with sType/pNext/pointers are appended member by member, the pointed-to
+	// state is appended separately. Structs made of 4 byte members only have no padding to hash
+	std::string EnginePipelineLibrary::MakeKey(
+		const std::string& vertFilePath,
+		const std::string& fragFilePath,
+		const PipelineConfigInfo& configInfo) {
+		std::string key;
+		key.reserve(512);
+
+		appendKey(key, vertFilePath);
+		appendKey(key, fragFilePath);
+
+		// Vertex input
+		appendKey(key, static_cast<uint32_t>(configInfo.bindingDescriptions.size()));
+		for (auto& binding : configInfo.bindingDescriptions)
+			appendKey(key, binding);
+		appendKey(key, static_cast<uint32_t>(configInfo.attributeDescriptions.size()));
+		for (auto& attribute : configInfo.attributeDescriptions)
+			appendKey(key, attribute);
+
+		// Input assembly and viewport (viewports and scissors themselves are dynamic)
+		appendKey(key, configInfo.inputAssemblyInfo.topology);
+		appendKey(key, configInfo.inputAssemblyInfo.primitiveRestartEnable);
+		appendKey(key, configInfo.viewportInfo.viewportCount);
+		appendKey(key, configInfo.viewportInfo.scissorCount);
+
+		// Rasterization
+		auto& raster = configInfo.rasterizationInfo;
+		appendKey(key, raster.depthClampEnable);
+		appendKey(key, raster.rasterizerDiscardEnable);
+		appendKey(key, raster.polygonMode);
+		appendKey(key, raster.cullMode);
+		appendKey(key, raster.frontFace);
+		appendKey(key, raster.depthBiasEnable);
+		appendKey(key, raster.depthBiasConstantFactor);
+		appendKey(key, raster.depthBiasClamp);
+		appendKey(key, raster.depthBiasSlopeFactor);
+		appendKey(key, raster.lineWidth);
+
+		// Multisampling
+		auto& multisample = configInfo.multisampleInfo;
+		assert(multisample.pSampleMask == nullptr && "Sample masks are not part of the pipeline key");
+		appendKey(key, multisample.rasterizationSamples);
+		appendKey(key, multisample.sampleShadingEnable);
+		appendKey(key, multisample.minSampleShading);
+		appendKey(key, multisample.alphaToCoverageEnable);
+		appendKey(key, multisample.alphaToOneEnable);
+
+		// Color blending
+		auto& blend = configInfo.colorBlendInfo;
+		appendKey(key, blend.logicOpEnable);
+		appendKey(key, blend.logicOp);
+		appendKey(key, blend.attachmentCount);
+		for (uint32_t i = 0; i < blend.attachmentCount; i++)
+			appendKey(key, blend.pAttachments[i]);
+		for (float constant : blend.blendConstants)
+			appendKey(key, constant);
+
+		// Depth and stencil
+		auto& depth = configInfo.depthStencilInfo;
+		appendKey(key, depth.depthTestEnable);
+		appendKey(key, depth.depthWriteEnable);
+		appendKey(key, depth.depthCompareOp);
+		appendKey(key, depth.depthBoundsTestEnable);
+		appendKey(key, depth.stencilTestEnable);
+		appendKey(key, depth.front);
+		appendKey(key, depth.back);
+		appendKey(key, depth.minDepthBounds);
+		appendKey(key, depth.maxDepthBounds);
+
+		// Dynamic state
+		appendKey(key, configInfo.dynamicStateInfo.dynamicStateCount);
+		for (uint32_t i = 0; i < configInfo.dynamicStateInfo.dynamicStateCount; i++)
+			appendKey(key, configInfo.dynamicStateInfo.pDynamicStates[i]);
+
+		// Specialization constants
+		appendKey(key, static_cast<uint32_t>(configInfo.specializationEntries.size()));
+		for (auto& entry : configInfo.specializationEntries) {
+			appendKey(key, entry.constantID);
+			appendKey(key, entry.offset);
+			appendKey(key, static_cast<uint64_t>(entry.size));
+		}
+		appendKey(key, static_cast<uint32_t>(configInfo.specializationData.size()));
+		key.append(
+			reinterpret_cast<const char*>(configInfo.specializationData.data()), 
+			configInfo.specializationData.size());
+
+		// Both handles are stable for the library's lifetime: the layout cache never destroys a layout
+		// and recreated swap chains take their render passes over (EngineSwapChain::canAdoptRenderPasses)
+		appendKey(key, configInfo.pipelineLayout);
+		appendKey(key, configInfo.renderPass);
+		appendKey(key, configInfo.subpass);
+
+		return key;
+	}
+
+	EnginePipelineHandle EnginePipelineLibrary::GetOrCreate(
+		const std::string& vertFilePath,
+		const std::string& fragFilePath,
+		std::unique_ptr<PipelineConfigInfo> configInfo,
+		EnginePipelineHandle fallback) {
+		assert(configInfo != nullptr && "Cannot look up a pipeline without a config");
+
+		std::string key = MakeKey(vertFilePath, fragFilePath, *configInfo);
+
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		auto it = pipelines.find(key);
+		if (it != pipelines.end()) {
+			stats.hits++;
+			return it->second;
+		}
+
+		stats.misses++;
+		auto handle = pipelineCompiler.Compile(vertFilePath, fragFilePath, std::move(configInfo), std::move(fallback));
+		pipelines.emplace(std::move(key), handle);
+		return handle;
+	}
+
+	size_t EnginePipelineLibrary::Size() const {
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		return pipelines.size();
+	}
+
+	EnginePipelineLibrary::Stats EnginePipelineLibrary::GetStats() const {
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		return stats;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "engine_pipeline.hpp"
+#include "engine_pipeline_compiler.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Engine {
+
+	// Deduplicates pipeline permutations. Every state that ends up in VkGraphicsPipelineCreateInfo is
+	// part of the key, so two requests only share a pipeline when they would have built identical ones
+	class EnginePipelineLibrary {
+	public:
+		struct Stats {
+			uint32_t hits = 0;
+			uint32_t misses = 0;
+		};
+
+		EnginePipelineLibrary(EnginePipelineCompiler& compiler) : pipelineCompiler{ compiler } {}
+
+		EnginePipelineLibrary(const EnginePipelineLibrary&) = delete;
+		EnginePipelineLibrary& operator=(const EnginePipelineLibrary&) = delete;
+
+		// Returns the existing pipeline for this permutation, or queues it on the compiler
+		EnginePipelineHandle GetOrCreate(
+			const std::string& vertFilePath,
+			const std::string& fragFilePath,
+			std::unique_ptr<PipelineConfigInfo> configInfo,
+			EnginePipelineHandle fallback = {});
+
+		static std::string MakeKey(
+			const std::string& vertFilePath,
+			const std::string& fragFilePath,
+			const PipelineConfigInfo& configInfo);
+
+		size_t Size() const;
+		Stats GetStats() const;
+
+	private:
+		EnginePipelineCompiler& pipelineCompiler;
+
+		mutable std::mutex libraryMutex;
+		// Keyed by the full serialized state rather than its hash so collisions can't alias pipelines
+		std::unordered_map<std::string, EnginePipelineHandle> pipelines;
+		Stats stats{};
+	};
+}
@@ -0,0 +1,128 @@
+#include "engine_profiler.hpp"
+#include "engine_utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Engine {
+
+	struct EngineProfiler::Registry {
+		std::mutex mutex;
+		// Never freed, events of finished threads stay exportable
+		std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+	};
+
+	EngineProfiler::Registry& EngineProfiler::registry() {
+		static Registry registry;
+		return registry;
+	}
+
+	EngineProfiler::ThreadBuffer& EngineProfiler::threadBuffer() {
+		thread_local ThreadBuffer* buffer = []() {
+			auto& registry = EngineProfiler::registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+			registry.threadBuffers.back()->threadId = static_cast<uint32_t>(registry.threadBuffers.size());
+			return registry.threadBuffers.back().get();
+		}();
+		return *buffer;
+	}
+
+	void EngineProfiler::push(const Event& event) {
+		auto& buffer = threadBuffer();
+		uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+		buffer.events[index % RING_CAPACITY].Store(event);
+		buffer.writeIndex.store(index + 1, std::memory_order_release);
+	}
+
+	void EngineProfiler::RecordZone(const char* name, uint64_t startNs, uint64_t endNs) {
+		push({ name, startNs, endNs - startNs, 0.0, EventType::Zone });
+	}
+
+	void EngineProfiler::RecordCounter(const char* name, double value) {
+		push({ name, Now(), 0, value, EventType::Counter });
+	}
+
+	void EngineProfiler::SetThreadName(const std::string& name) {
+		auto& buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		buffer.name = name;
+	}
+
+	bool EngineProfiler::WriteChromeTrace(const std::string& filePath) {
+		std::ofstream file{ filePath };
+		if (!file.is_open())
+			return false;
+
+		auto& registry = EngineProfiler::registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		// Copied out seqlock style, writers keep running. Writing event i overwrites event
+		// i - RING_CAPACITY, so once the copy is done every copied event at or below the writer's
+		// index minus RING_CAPACITY may be torn and is dropped
+		struct Range {
+			ThreadBuffer* buffer;
+			std::vector<Event> events;
+		};
+		std::vector<Range> ranges;
+		for (auto& buffer : registry.threadBuffers) {
+			uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+			uint64_t first = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+			std::vector<Event> events;
+			events.reserve(end - first);
+			for (uint64_t i = first; i < end; i++)
+				events.push_back(buffer->events[i % RING_CAPACITY].Load());
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t writing = buffer->writeIndex.load(std::memory_order_relaxed);
+			uint64_t overwritten = writing >= RING_CAPACITY ? writing - RING_CAPACITY + 1 : 0;
+			if (overwritten > first)
+				events.erase(events.begin(), events.begin() + std::min(overwritten - first, end - first));
+			ranges.push_back({ buffer.get(), std::move(events) });
+		}
+
+		// Timestamps are relative to the oldest exported event
+		uint64_t baseNs = std::numeric_limits<uint64_t>::max();
+		for (auto& range : ranges) {
+			for (auto& event : range.events)
+				baseNs = std::min(baseNs, event.startNs);
+		}
+
+		// Microseconds, with nanosecond precision
+		char number[32];
+		auto microseconds = [&](uint64_t nanoseconds) {
+			std::snprintf(number, sizeof(number), "%.3f", nanoseconds / 1000.0);
+			return number;
+		};
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		const char* separator = "\n";
+		for (auto& range : ranges) {
+			uint32_t tid = range.buffer->threadId;
+			if (!range.buffer->name.empty()) {
+				file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+					<< ",\"args\":{\"name\":" << JsonString(range.buffer->name) << "}}";
+				separator = ",\n";
+			}
+
+			for (const Event& event : range.events) {
+				file << separator << "{\"name\":" << JsonString(event.name) << ",\"pid\":1,\"tid\":" << tid
+					<< ",\"ts\":" << microseconds(event.startNs - baseNs);
+				if (event.type == EventType::Zone) {
+					file << ",\"ph\":\"X\",\"dur\":" << microseconds(event.durationNs) << "}";
+				}
+				else {
+					file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+				}
+				separator = ",\n";
+			}
+		}
+		file << "\n]}\n";
+		return file.good();
+	}
+}
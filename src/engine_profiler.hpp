@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Engine {
+
+	// CPU profiler. Each thread records zones and counters into its own ring buffer without locks,
+	// only the first event of a thread takes a lock to register its buffer. Buffers keep the latest
+	// RING_CAPACITY events of their thread and outlive it, WriteChromeTrace exports all of them as
+	// Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+	// Record through the ENGINE_PROFILE_* macros, they compile to nothing unless ENGINE_ENABLE_PROFILER
+	// is defined (CMake option ENGINE_PROFILER)
+	class EngineProfiler {
+	public:
+		static constexpr uint32_t RING_CAPACITY = 1 << 15;
+
+		static uint64_t Now() {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// name must outlive the export, pass string literals
+		static void RecordZone(const char* name, uint64_t startNs, uint64_t endNs);
+		static void RecordCounter(const char* name, double value);
+		// Shown in place of the thread id
+		static void SetThreadName(const std::string& name);
+
+		// Safe while other threads record, events they overwrite during the export are left out.
+		// Returns false if the file couldn't be written
+		static bool WriteChromeTrace(const std::string& filePath);
+
+		static constexpr bool IsEnabled() {
+#ifdef ENGINE_ENABLE_PROFILER
+			return true;
+#else
+			return false;
+#endif
+		}
+
+	private:
+		enum class EventType : uint8_t { Zone, Counter };
+
+		struct Event {
+			const char* name;
+			uint64_t startNs;
+			uint64_t durationNs;
+			double value;
+			EventType type;
+		};
+
+		// An Event in the ring. The export reads slots while their thread may be overwriting them,
+		// so every field is a relaxed atomic; a torn copy is still well defined and gets dropped
+		struct EventSlot {
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<uint64_t> startNs{ 0 };
+			std::atomic<uint64_t> durationNs{ 0 };
+			std::atomic<double> value{ 0.0 };
+			std::atomic<EventType> type{ EventType::Zone };
+
+			void Store(const Event& event) {
+				name.store(event.name, std::memory_order_relaxed);
+				startNs.store(event.startNs, std::memory_order_relaxed);
+				durationNs.store(event.durationNs, std::memory_order_relaxed);
+				value.store(event.value, std::memory_order_relaxed);
+				type.store(event.type, std::memory_order_relaxed);
+			}
+
+			Event Load() const {
+				return { name.load(std::memory_order_relaxed), startNs.load(std::memory_order_relaxed),
+					durationNs.load(std::memory_order_relaxed), value.load(std::memory_order_relaxed),
+					type.load(std::memory_order_relaxed) };
+			}
+		};
+
+		// Written only by its thread. An event is published by the release store of writeIndex,
+		// the export rereads writeIndex after copying to find the events overwritten meanwhile
+		struct ThreadBuffer {
+			std::array<EventSlot, RING_CAPACITY> events;
+			std::atomic<uint64_t> writeIndex{ 0 };
+			uint32_t threadId = 0;
+			std::string name;
+		};
+
+		// Every thread's buffer and the lock for registering them
+		struct Registry;
+
+		static Registry& registry();
+		static ThreadBuffer& threadBuffer();
+		static void push(const Event& event);
+	};
+
+	class EngineProfileZone {
+	public:
+		explicit EngineProfileZone(const char* name) : name(name), startNs(EngineProfiler::Now()) {}
+		~EngineProfileZone() { EngineProfiler::RecordZone(name, startNs, EngineProfiler::Now()); }
+
+		EngineProfileZone(const EngineProfileZone&) = delete;
+		EngineProfileZone& operator=(const EngineProfileZone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t startNs;
+	};
+}
+
+#ifdef ENGINE_ENABLE_PROFILER
+	#define ENGINE_PROFILE_CONCAT_INNER(a, b) a##b
+	#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_INNER(a, b)
+	// Times the rest of the enclosing scope
+	#define ENGINE_PROFILE_ZONE(name) ::Engine::EngineProfileZone ENGINE_PROFILE_CONCAT(profileZone, __LINE__){ name }
+	#define ENGINE_PROFILE_FUNCTION() ENGINE_PROFILE_ZONE(__func__)
+	#define ENGINE_PROFILE_COUNTER(name, value) ::Engine::EngineProfiler::RecordCounter(name, static_cast<double>(value))
+	#define ENGINE_PROFILE_THREAD_NAME(name) ::Engine::EngineProfiler::SetThreadName(name)
+#else
+	#define ENGINE_PROFILE_ZONE(name)
+	#define ENGINE_PROFILE_FUNCTION()
+	#define ENGINE_PROFILE_COUNTER(name, value)
+	#define ENGINE_PROFILE_THREAD_NAME(name)
+#endif
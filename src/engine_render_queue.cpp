@@ -0,0 +1,187 @@
+#include "engine_render_queue.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace Engine {
+
+	// Histograms of every pass live on the stack and are hit at random, keep them well inside L1d
+	static constexpr size_t RADIX_HISTOGRAM_BYTES = 16 * 1024;
+
+	// Stable LSD radix sort of items by the low keyBits of their integer key member, ascending, in
+	// digitBits wide digits. Passes where every key shares the digit are skipped, so constant high
+	// bits cost nothing. Wide digits mean fewer passes but larger histograms: 11 bits suit short
+	// keys (2 passes, 16 KB for 22 bits), 8 bits keep a 64 bit key at 8 passes in 8 KB
+	template <uint32_t keyBits, uint32_t digitBits, typename Item>
+	static void radixSort(std::vector<Item>& items, std::vector<Item>& scratch) {
+		static_assert(keyBits <= sizeof(Item::key) * 8, "Sorting more bits than the key has");
+		constexpr uint32_t radixSize = 1 << digitBits;
+		constexpr uint32_t passCount = (keyBits + digitBits - 1) / digitBits;
+		static_assert(passCount * radixSize * sizeof(uint32_t) <= RADIX_HISTOGRAM_BYTES,
+			"Radix histograms outgrow L1, use narrower digits");
+
+		const size_t count = items.size();
+		if (count < 2)
+			return;
+		scratch.resize(count);
+
+		// Histograms of all passes in one read over the keys
+		uint32_t histograms[passCount][radixSize] = {};
+		for (auto& item : items) {
+			for (uint32_t pass = 0; pass < passCount; pass++)
+				histograms[pass][(item.key >> (pass * digitBits)) & (radixSize - 1)]++;
+		}
+
+		Item* source = items.data();
+		Item* destination = scratch.data();
+		for (uint32_t pass = 0; pass < passCount; pass++) {
+			uint32_t* histogram = histograms[pass];
+			uint32_t shift = pass * digitBits;
+
+			if (histogram[(source[0].key >> shift) & (radixSize - 1)] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < radixSize; digit++) {
+				uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			// Stable scatter, equal keys keep their push order
+			for (size_t i = 0; i < count; i++) {
+				const Item& item = source[i];
+				destination[histogram[(item.key >> shift) & (radixSize - 1)]++] = item;
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != items.data())
+			items.swap(scratch);
+	}
+
+	uint32_t EngineTransparentQueue::DepthToKey(float depth) {
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		// Positive floats already order as integers once the sign bit is set,
+		// negative ones order backwards so every bit is flipped
+		uint32_t mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+		return bits ^ mask;
+	}
+
+	void EngineTransparentQueue::Reserve(size_t count) {
+		items.reserve(count);
+		scratch.reserve(count);
+	}
+
+	void EngineTransparentQueue::Push(float depth, uint32_t payload) {
+		// Inverted so an ascending sort yields the farthest item first
+		items.push_back({ ~DepthToKey(depth) >> (32 - KEY_BITS), payload });
+	}
+
+	void EngineTransparentQueue::SortBackToFront() {
+		radixSort<KEY_BITS, 11>(items, scratch);
+	}
+
+	static constexpr uint32_t KEY_ID_BITS = 12;
+	static constexpr uint32_t KEY_DEPTH_BITS = 24;
+	static constexpr uint64_t KEY_ID_MASK = (1u << KEY_ID_BITS) - 1;
+
+	template <typename Map, typename Key>
+	static uint32_t internId(Map& ids, const Key& key) {
+		return ids.emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+	}
+
+	void EngineDrawQueue::Push(DrawPass pass, float viewDepth, const Packet& packet, const void* pushConstants) {
+		assert(packet.pipeline != nullptr && packet.model != nullptr && "Draw packet needs a pipeline and a model");
+		assert(packet.descriptorSetCount <= MAX_DESCRIPTOR_SETS && "Too many descriptor sets in draw packet");
+
+		DescriptorSetList setList{};
+		for (uint32_t i = 0; i < packet.descriptorSetCount; i++)
+			setList[i] = packet.descriptorSets[i];
+
+		uint64_t key = static_cast<uint64_t>(pass) << (64 - 4);
+		key |= (internId(pipelineIds, static_cast<const void*>(packet.pipeline)) & KEY_ID_MASK) << (KEY_DEPTH_BITS + 2 * KEY_ID_BITS);
+		key |= (internId(descriptorSetIds, setList) & KEY_ID_MASK) << (KEY_DEPTH_BITS + KEY_ID_BITS);
+		key |= (internId(modelIds, static_cast<const void*>(packet.model)) & KEY_ID_MASK) << KEY_DEPTH_BITS;
+		// Front to back inside a state group so early depth testing rejects more
+		key |= EngineTransparentQueue::DepthToKey(viewDepth) >> (32 - KEY_DEPTH_BITS);
+
+		Packet stored = packet;
+		stored.descriptorSets = setList;
+		stored.pushConstantOffset = static_cast<uint32_t>(pushConstantData.size());
+		if (packet.pushConstantSize > 0) {
+			auto bytes = static_cast<const unsigned char*>(pushConstants);
+			pushConstantData.insert(pushConstantData.end(), bytes, bytes + packet.pushConstantSize);
+		}
+
+		items.push_back({ key, static_cast<uint32_t>(packets.size()) });
+		packets.push_back(stored);
+	}
+
+	void EngineDrawQueue::Flush(EngineCommandRecorder& recorder) {
+		radixSort<64, 8>(items, scratch);
+
+		// Sorted neighbours mostly share state, the recorder skips what is already bound
+		for (size_t i = 0; i < items.size(); i++) {
+			const Packet& packet = packets[items[i].packet];
+			packet.pipeline->Bind(recorder);
+			for (uint32_t set = 0; set < packet.descriptorSetCount; set++) {
+				if (packet.descriptorSets[set] == VK_NULL_HANDLE)
+					continue;
+				// Dynamic sets go alone so the recorder can match their offsets
+				if (packet.dynamicSetMask & (1u << set)) {
+					recorder.BindDescriptorSets(
+						packet.pipelineLayout,
+						set, 1,
+						&packet.descriptorSets[set],
+						1, &packet.dynamicOffsets[set]);
+					continue;
+				}
+				uint32_t runEnd = set + 1;
+				while (runEnd < packet.descriptorSetCount && packet.descriptorSets[runEnd] != VK_NULL_HANDLE &&
+					!(packet.dynamicSetMask & (1u << runEnd)))
+					runEnd++;
+				recorder.BindDescriptorSets(
+					packet.pipelineLayout,
+					set, runEnd - set,
+					packet.descriptorSets.data() + set);
+				set = runEnd - 1;
+			}
+			if (packet.pushConstantSize > 0) {
+				recorder.PushConstants(
+					packet.pipelineLayout,
+					packet.pushConstantStages,
+					0,
+					packet.pushConstantSize,
+					pushConstantData.data() + packet.pushConstantOffset);
+			}
+
+			uint32_t instanceCount = 1;
+			while (packet.pushConstantSize == 0 && i + 1 < items.size()) {
+				const Packet& next = packets[items[i + 1].packet];
+				if (next.firstInstance != packet.firstInstance + instanceCount ||
+					next.pipeline != packet.pipeline ||
+					next.pipelineLayout != packet.pipelineLayout ||
+					next.descriptorSets != packet.descriptorSets ||
+					next.dynamicSetMask != packet.dynamicSetMask ||
+					next.dynamicOffsets != packet.dynamicOffsets ||
+					next.model != packet.model ||
+					next.pushConstantSize != 0)
+					break;
+				instanceCount++;
+				i++;
+			}
+
+			packet.model->Bind(recorder);
+			packet.model->Draw(recorder, instanceCount, packet.firstInstance);
+		}
+
+		packets.clear();
+		items.clear();
+		pushConstantData.clear();
+		pipelineIds.clear();
+		descriptorSetIds.clear();
+		modelIds.clear();
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "engine_pipeline.hpp"
+#include "engine_model.hpp"
+#include "engine_command_recorder.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+
+	// Per-frame queue of blended draws sorted by depth. Systems push one item per draw with a
+	// payload of their choosing (usually an index into their own per-frame data), sort, then
+	// walk the items in order. Depths become KEY_BITS wide keys that sort the same way as the
+	// floats down to a relative difference of 2^-13, closer depths and equal ones keep their push
+	// order and nothing is dropped.
+	// Sorting is a two pass LSD radix sort into a scratch array, both arrays keep their capacity
+	// between frames so a steady scene doesn't allocate
+	class EngineTransparentQueue {
+	public:
+		// Sign, exponent and the top 13 mantissa bits of the depth
+		static constexpr uint32_t KEY_BITS = 22;
+
+		struct Item {
+			uint32_t key;
+			uint32_t payload;
+		};
+
+		EngineTransparentQueue() = default;
+		EngineTransparentQueue(const EngineTransparentQueue&) = delete;
+		EngineTransparentQueue& operator=(const EngineTransparentQueue&) = delete;
+
+		void Clear() { items.clear(); }
+		void Reserve(size_t count);
+		// depth is any value growing away from the camera, view depth or squared distance
+		void Push(float depth, uint32_t payload);
+		// Farthest first, the order alpha blending needs
+		void SortBackToFront();
+
+		bool Empty() const { return items.empty(); }
+		size_t Size() const { return items.size(); }
+		const Item* begin() const { return items.data(); }
+		const Item* end() const { return items.data() + items.size(); }
+		const Item& operator[](size_t index) const { return items[index]; }
+
+		// Maps a float onto a uint32 with the same ordering, negative values included
+		static uint32_t DepthToKey(float depth);
+
+	private:
+		std::vector<Item> items;
+		std::vector<Item> scratch;
+	};
+
+	// Order in which the packets of a flush are drawn, the top bits of the sort key
+	enum DrawPass : uint32_t {
+		DRAW_PASS_OPAQUE = 0,
+	};
+
+	// Opaque draw packets recorded sorted by a 64 bit state key:
+	//   pass (4) | pipeline (12) | descriptor sets (12) | model (12) | depth front to back (24)
+	// so packets sharing a pipeline, descriptor sets and model end up next to each other and
+	// the command recorder drops the binds repeated between them. Pipelines, set lists and models
+	// get small ids in the order they're first pushed, ids past 12 bits wrap, which only costs
+	// grouping. Neighbours differing only in consecutive firstInstance values, without push
+	// constants, are merged into one instanced draw.
+	// Blended geometry needs back to front order over state, use EngineTransparentQueue for it
+	class EngineDrawQueue {
+	public:
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+
+		struct Packet {
+			EnginePipeline* pipeline = nullptr;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			// Bound from set 0, VK_NULL_HANDLE entries are left unbound
+			std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> descriptorSets{};
+			uint32_t descriptorSetCount = 0;
+			// Sets with one dynamic buffer each, bound with dynamicOffsets[set]
+			uint32_t dynamicSetMask = 0;
+			std::array<uint32_t, MAX_DESCRIPTOR_SETS> dynamicOffsets{};
+			EngineModel* model = nullptr;
+			// Usually the object's index in EngineObjectBuffer
+			uint32_t firstInstance = 0;
+			VkShaderStageFlags pushConstantStages = 0;
+			uint32_t pushConstantSize = 0;
+			// Offset into the queue's push constant arena, filled by Push
+			uint32_t pushConstantOffset = 0;
+		};
+
+		EngineDrawQueue() = default;
+		EngineDrawQueue(const EngineDrawQueue&) = delete;
+		EngineDrawQueue& operator=(const EngineDrawQueue&) = delete;
+
+		// pushConstants holds packet.pushConstantSize bytes pushed at offset 0 before the draw
+		void Push(DrawPass pass, float viewDepth, const Packet& packet, const void* pushConstants);
+		// Sorts, records every packet through recorder and empties the queue
+		void Flush(EngineCommandRecorder& recorder);
+
+		bool Empty() const { return packets.empty(); }
+
+	private:
+		struct SortItem {
+			uint64_t key;
+			uint32_t packet;
+		};
+
+		using DescriptorSetList = std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS>;
+
+		std::vector<Packet> packets;
+		std::vector<SortItem> items;
+		std::vector<SortItem> scratch;
+		std::vector<unsigned char> pushConstantData;
+		std::unordered_map<const void*, uint32_t> pipelineIds;
+		std::unordered_map<const void*, uint32_t> modelIds;
+		std::map<DescriptorSetList, uint32_t> descriptorSetIds;
+	};
+}
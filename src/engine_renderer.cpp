@@ -1,39 +1,239 @@
 #include "engine_renderer.hpp"
+#include "engine_profiler.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 
 
 namespace Engine {
 
-	EngineRenderer::EngineRenderer(EngineWindow& window, EngineDevice& device)
-		: engineWindow(window), engineDevice(device) {
+	EngineRenderer::EngineRenderer(EngineWindow& window, EngineDevice& device, const EngineSwapChain::Settings& settings)
+		: engineWindow(&window), engineDevice(device),
+		gBufferAllocator(device),
+		gBufferSetCache(gBufferAllocator, EngineSwapChain::MAX_FRAMES_IN_FLIGHT),
+		swapChainSettings(settings) {
+		assert(!device.isHeadless() && "A windowed renderer needs a device with a surface");
+		init();
+	}
+
+	EngineRenderer::EngineRenderer(EngineDevice& device, VkExtent2D extent, const EngineSwapChain::Settings& settings)
+		: engineDevice(device),
+		gBufferAllocator(device),
+		gBufferSetCache(gBufferAllocator, EngineSwapChain::MAX_FRAMES_IN_FLIGHT),
+		swapChainSettings(settings),
+		offscreenExtent(extent) {
+		assert(device.isHeadless() && "A headless renderer needs a headless device");
+		init();
+	}
+
+	void EngineRenderer::init() {
+		swapChainSettings.framesInFlight = std::clamp(
+			swapChainSettings.framesInFlight, 1u, static_cast<uint32_t>(EngineSwapChain::MAX_FRAMES_IN_FLIGHT));
+		if (IsDeferred()) {
+			gBufferSetLayout = EngineDescriptorSetLayout::Builder(engineDevice)
+				.addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_ALL_GRAPHICS)
+				.addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_ALL_GRAPHICS)
+				.addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_ALL_GRAPHICS)
+				.build();
+		}
 		recreateSwapchain();
 		createCommandBuffers();
 	}
 
 	EngineRenderer::~EngineRenderer() { 
+		// Pending readbacks read from buffers owned here, even once the callback was cleared
+		if (pendingReadbacks > 0) {
+			FlushReadbacks();
+		}
+		assert(pendingReadbacks == 0 && "Readbacks still pending after the flush");
 		freeCommandBuffers();
 	}
 
 	void EngineRenderer::recreateSwapchain() {
-		auto extent = engineWindow.GetExtent();
-		while (extent.width == 0 || extent.height == 0) {
-			extent = engineWindow.GetExtent();
-			glfwWaitEvents();
+		VkExtent2D extent = offscreenExtent;
+		if (engineWindow != nullptr) {
+			extent = engineWindow->GetExtent();
+			while (extent.width == 0 || extent.height == 0) {
+				extent = engineWindow->GetExtent();
+				glfwWaitEvents();
+			}
 		}
 
-		vkDeviceWaitIdle(engineDevice.device());
+		// No idle wait, frames in flight finish on the old swap chain and the deletion queue frees it
+		swapchainRecreatePending = false;
+		settingsChanged = false;
 		if (engineSwapChain == nullptr)
-			engineSwapChain = std::make_unique<EngineSwapChain>(engineDevice, extent);
+			engineSwapChain = std::make_unique<EngineSwapChain>(engineDevice, extent, swapChainSettings);
 		else {
 			std::shared_ptr<EngineSwapChain> oldSwapChain = std::move(engineSwapChain);
-			engineSwapChain = std::make_unique<EngineSwapChain>(engineDevice, extent, oldSwapChain);
+			invalidateGBufferDescriptorSets(*oldSwapChain);
+			engineSwapChain = std::make_unique<EngineSwapChain>(engineDevice, extent, swapChainSettings, oldSwapChain);
 
 			if (!oldSwapChain->CompareSwapFormats(*engineSwapChain.get())) {
 				throw std::runtime_error("Swapchain image(or depth) format has changed!");
 			}
 
+			releaseDroppedFrames(*oldSwapChain);
+		}
+		createGBufferDescriptorSets();
+		// Present ids belong to the replaced swap chain, frames still waiting for present aren't sampled
+		for (int i = 0; i < EngineSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			if (framePresentIds[i] != 0)
+				frameLatencyValues[i] = 0;
+		}
+		currentFrameIndex %= swapChainSettings.framesInFlight;
+	}
+
+	void EngineRenderer::releaseDroppedFrames(EngineSwapChain& oldSwapChain) {
+		// Slots past a lowered frame count aren't begun again, so nothing else would release what
+		// they hold. Waits for their last frames, a stall only taken when the setting changes
+		int oldFramesInFlight = static_cast<int>(oldSwapChain.getSettings().framesInFlight);
+		for (int i = static_cast<int>(swapChainSettings.framesInFlight); i < oldFramesInFlight; i++) {
+			engineDevice.timeline().Wait(oldSwapChain.getFrameTimelineValue(i));
+			gBufferSetCache.ReleaseFrame(i);
+			if (frameReleaseCallback)
+				frameReleaseCallback(i);
+		}
+	}
+
+	void EngineRenderer::SetPresentMode(VkPresentModeKHR presentMode) {
+		// Against the mode in use, a request that fell back to FIFO would otherwise never be retried
+		swapChainSettings.presentMode = presentMode;
+		if (presentMode != GetPresentMode())
+			settingsChanged = true;
+	}
+
+	bool EngineRenderer::IsPresentModeSupported(VkPresentModeKHR presentMode) {
+		// Offscreen images aren't presented, any mode goes
+		if (IsHeadless())
+			return true;
+		auto presentModes = engineDevice.getSwapChainSupport().presentModes;
+		return std::find(presentModes.begin(), presentModes.end(), presentMode) != presentModes.end();
+	}
+
+	void EngineRenderer::SetFramesInFlight(uint32_t framesInFlight) {
+		framesInFlight = std::clamp(framesInFlight, 1u, static_cast<uint32_t>(EngineSwapChain::MAX_FRAMES_IN_FLIGHT));
+		if (framesInFlight == swapChainSettings.framesInFlight)
+			return;
+		swapChainSettings.framesInFlight = framesInFlight;
+		settingsChanged = true;
+	}
+
+	void EngineRenderer::SetExtent(VkExtent2D extent) {
+		assert(IsHeadless() && "The window decides the extent of a windowed renderer");
+		if (extent.width == offscreenExtent.width && extent.height == offscreenExtent.height)
+			return;
+		offscreenExtent = extent;
+		settingsChanged = true;
+	}
+
+	void EngineRenderer::SetReadbackCallback(ReadbackCallback callback) {
+		assert(IsHeadless() && "Only offscreen images can be read back");
+		if (!callback && pendingReadbacks > 0) {
+			FlushReadbacks();
+		}
+		readbackCallback = std::move(callback);
+	}
+
+	void EngineRenderer::recordReadback(VkCommandBuffer commandBuffer) {
+		// The render pass left the image in TRANSFER_SRC_OPTIMAL with its writes visible to transfers
+		VkExtent2D extent = engineSwapChain->getSwapChainExtent();
+		const uint32_t bytesPerPixel = 4;
+		uint32_t pixelCount = extent.width * extent.height;
+
+		auto& buffer = readbackBuffers[currentFrameIndex];
+		if (buffer == nullptr || buffer->getInstanceCount() < pixelCount) {
+			buffer = std::make_unique<EngineBuffer>(
+				engineDevice,
+				bytesPerPixel,
+				pixelCount,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			buffer->map();
+		}
+
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(
+			commandBuffer,
+			engineSwapChain->getImage(currentImageIndex),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			buffer->getBuffer(),
+			1,
+			&region);
+
+		VkMemoryBarrier hostBarrier{};
+		hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &hostBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void EngineRenderer::sampleLatency() {
+		auto now = std::chrono::steady_clock::now();
+		auto& timeline = engineDevice.timeline();
+		for (int i = 0; i < EngineSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			if (frameLatencyValues[i] == 0)
+				continue;
+			if (framePresentIds[i] != 0) {
+				VkResult result = engineSwapChain->waitForPresent(framePresentIds[i], 0);
+				if (result == VK_TIMEOUT)
+					continue;
+				frameLatencyValues[i] = 0;
+				// Out of date or lost, the frame never reached the screen
+				if (result != VK_SUCCESS)
+					continue;
+			}
+			else {
+				if (!timeline.IsComplete(frameLatencyValues[i]))
+					continue;
+				frameLatencyValues[i] = 0;
+			}
+
+			double latencyMs = std::chrono::duration<double, std::milli>(now - frameStartTimes[i]).count();
+			latencyStats.lastMs = latencyMs;
+			latencyStats.averageMs = latencyStats.samples == 0 ? latencyMs : latencyStats.averageMs * 0.9 + latencyMs * 0.1;
+			latencyStats.maxMs = std::max(latencyStats.maxMs, latencyMs);
+			latencyStats.samples++;
+			latencyStats.present = framePresentIds[i] != 0;
+		}
+	}
+
+	void EngineRenderer::createGBufferDescriptorSets() {
+		if (!IsDeferred())
+			return;
+		uint32_t imageCount = static_cast<uint32_t>(engineSwapChain->imageCount());
+		gBufferDescriptorSets.resize(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++) {
+			VkDescriptorImageInfo albedoInfo{ VK_NULL_HANDLE, engineSwapChain->getGBufferAlbedoView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			VkDescriptorImageInfo normalInfo{ VK_NULL_HANDLE, engineSwapChain->getGBufferNormalView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			VkDescriptorImageInfo depthInfo{ VK_NULL_HANDLE, engineSwapChain->getDepthImageView(i), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+			EngineDescriptorWriter(*gBufferSetLayout, gBufferAllocator)
+				.writeImage(0, &albedoInfo)
+				.writeImage(1, &normalInfo)
+				.writeImage(2, &depthInfo)
+				.build(gBufferDescriptorSets[i], gBufferSetCache);
+		}
+	}
+
+	void EngineRenderer::invalidateGBufferDescriptorSets(EngineSwapChain& swapChain) {
+		if (!IsDeferred())
+			return;
+		// The views die with the swap chain
+		for (int i = 0; i < static_cast<int>(swapChain.imageCount()); i++) {
+			gBufferSetCache.InvalidateImageView(swapChain.getGBufferAlbedoView(i));
+			gBufferSetCache.InvalidateImageView(swapChain.getGBufferNormalView(i));
+			gBufferSetCache.InvalidateImageView(swapChain.getDepthImageView(i));
 		}
 	}
 
@@ -66,8 +266,24 @@ namespace Engine {
 
 	VkCommandBuffer EngineRenderer::BeginFrame() {
 		assert(!isFrameStarted && "Can't call begin frame while already in progress");
+		ENGINE_PROFILE_ZONE("BeginFrame");
+		auto frameStartTime = std::chrono::steady_clock::now();
+
+		if (settingsChanged) {
+			recreateSwapchain();
+		}
+
+		// A suboptimal swap chain still presents, wait until the window stops changing size for a
+		// frame so a drag resize recreates it once instead of every frame
+		if (swapchainRecreatePending) {
+			VkExtent2D extent = engineWindow->GetExtent();
+			if (extent.width == pendingExtent.width && extent.height == pendingExtent.height)
+				recreateSwapchain();
+			else
+				pendingExtent = extent;
+		}
 
-		auto result = engineSwapChain->acquireNextImage(&currentImageIndex);
+		auto result = engineSwapChain->acquireNextImage(currentFrameIndex, &currentImageIndex);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapchain();
@@ -78,6 +294,12 @@ namespace Engine {
 			throw std::runtime_error("Failed to acquire swap chain image!");
 		}
 
+		// Work retired while waiting for the frame slot, e.g. finished uploads, is released now
+		engineDevice.timeline().Poll();
+		engineDevice.deletionQueue().Collect();
+		sampleLatency();
+		frameStartTimes[currentFrameIndex] = frameStartTime;
+
 		isFrameStarted = true;
 		auto commandBuffer = GetCurrentCommandBuffer();
 
@@ -86,48 +308,120 @@ namespace Engine {
 		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to begin recording command buffer!");
 		}
+		commandRecorder.Reset(commandBuffer);
+		gBufferSetCache.BeginFrame(currentFrameIndex);
 
 		return commandBuffer;
 	}
 
 	void EngineRenderer::EndFrame() {
 		assert(isFrameStarted && "Can't call end frame while frame is not in progress");
+		ENGINE_PROFILE_ZONE("EndFrame");
 
 		auto commandBuffer = GetCurrentCommandBuffer();
 
+		bool readback = static_cast<bool>(readbackCallback);
+		if (readback) {
+			recordReadback(commandBuffer);
+		}
+
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to record command buffer");
 		}
 
-		auto result = engineSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		auto result = engineSwapChain->submitCommandBuffers(currentFrameIndex, &commandBuffer, &currentImageIndex);
+		uint64_t timelineValue = engineSwapChain->getFrameTimelineValue(currentFrameIndex);
+		// A slot still waiting for its previous present drops that sample, mailbox may never show it
+		frameLatencyValues[currentFrameIndex] = timelineValue;
+		framePresentIds[currentFrameIndex] = engineSwapChain->getLastPresentId();
+		frameNumber++;
+
+		if (readback) {
+			ReadbackImage image{};
+			image.pixels = readbackBuffers[currentFrameIndex]->getMappedMemory();
+			image.extent = engineSwapChain->getSwapChainExtent();
+			image.format = engineSwapChain->getSwapChainImageFormat();
+			image.rowPitch = image.extent.width * 4;
+			image.frameNumber = frameNumber;
+			// Fires before the frame slot records again, so the buffer isn't overwritten yet
+			pendingReadbacks++;
+			engineDevice.timeline().OnComplete(timelineValue, [this, callback = readbackCallback, image]() {
+				pendingReadbacks--;
+				callback(image);
+			});
+		}
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || engineWindow.WasWindowResized()) {
-			engineWindow.ResetWindowResizedFlag();
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// Can't present to it anymore
+			if (engineWindow != nullptr)
+				engineWindow->ResetWindowResizedFlag();
 			recreateSwapchain();
 		}
+		else if (engineWindow != nullptr && (result == VK_SUBOPTIMAL_KHR || engineWindow->WasWindowResized())) {
+			engineWindow->ResetWindowResizedFlag();
+			if (!swapchainRecreatePending) {
+				swapchainRecreatePending = true;
+				pendingExtent = engineWindow->GetExtent();
+			}
+		}
 		else if (result != VK_SUCCESS) {
 			throw std::runtime_error("Failed to present swap chain image!");
 		}
 
 		isFrameStarted = false;
-		currentFrameIndex = (currentFrameIndex + 1) % EngineSwapChain::MAX_FRAMES_IN_FLIGHT;
+		currentFrameIndex = (currentFrameIndex + 1) % swapChainSettings.framesInFlight;
 	}
 
 	void EngineRenderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 		assert(isFrameStarted && "Can't call begin BeginSwapChainRenderPass while frame is not in progress");
 		assert(commandBuffer == GetCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
 
+		std::vector<VkClearValue> clearValues(2);
+		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		beginRenderPass(
+			commandBuffer, 
+			engineSwapChain->getRenderPass(), 
+			engineSwapChain->getFrameBuffer(currentImageIndex), 
+			clearValues);
+	}
+
+	void EngineRenderer::BeginDeferredRenderPass(VkCommandBuffer commandBuffer) {
+		assert(isFrameStarted && "Can't call BeginDeferredRenderPass while frame is not in progress");
+		assert(IsDeferred() && "The deferred render pass is only built with Settings::deferred");
+		assert(commandBuffer == GetCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
+
+		std::vector<VkClearValue> clearValues(4);
+		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		clearValues[2].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		clearValues[3].color = { 0.5f, 0.5f, 0.5f, 0.0f };
+		beginRenderPass(
+			commandBuffer,
+			engineSwapChain->getDeferredRenderPass(),
+			engineSwapChain->getDeferredFrameBuffer(currentImageIndex),
+			clearValues);
+	}
+
+	void EngineRenderer::NextSubpass(VkCommandBuffer commandBuffer) {
+		assert(isFrameStarted && "Can't call NextSubpass while frame is not in progress");
+		assert(commandBuffer == GetCurrentCommandBuffer() && "Can't advance render pass on command buffer from a different frame");
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	void EngineRenderer::beginRenderPass(
+		VkCommandBuffer commandBuffer,
+		VkRenderPass renderPass,
+		VkFramebuffer framebuffer,
+		const std::vector<VkClearValue>& clearValues) {
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = engineSwapChain->getRenderPass();
-		renderPassInfo.framebuffer = engineSwapChain->getFrameBuffer(currentImageIndex);
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
 
 		renderPassInfo.renderArea.offset = { 0,0 };
 		renderPassInfo.renderArea.extent = engineSwapChain->getSwapChainExtent();
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
@@ -1,10 +1,18 @@
 #pragma once
 
 #include "engine_device.hpp"
+#include "engine_buffer.hpp"
 #include "engine_window.hpp"
 #include "engine_swap_chain.hpp"
 #include "engine_model.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_descriptor_set_cache.hpp"
+#include "engine_command_recorder.hpp"
 
+#include <array>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -14,39 +22,155 @@ namespace Engine {
 
 	class EngineRenderer {
 	public:
-		EngineRenderer(EngineWindow& window, EngineDevice& device);
+		// CPU time from BeginFrame until the frame was observed on screen through VK_KHR_present_wait.
+		// Without it, and when headless, only until the GPU was observed to have finished the frame.
+		// Observed at the next BeginFrame, so samples are rounded up to the frame time
+		struct LatencyStats {
+			double lastMs = 0.0;
+			double averageMs = 0.0; // exponential moving average
+			double maxMs = 0.0;
+			uint64_t samples = 0;
+			// False when the samples measure frame completion rather than present
+			bool present = false;
+		};
+
+		// A frame's color image copied to host memory, pixels is only valid during the callback
+		struct ReadbackImage {
+			const void* pixels;
+			VkExtent2D extent;
+			VkFormat format;
+			uint32_t rowPitch;
+			uint64_t frameNumber;
+		};
+		using ReadbackCallback = std::function<void(const ReadbackImage&)>;
+		// Called once per frame slot a lowered frames in flight stops using, after the frame last
+		// recorded in it finished. Owners of per-slot state release the slot's share from here
+		using FrameReleaseCallback = std::function<void(int frameIndex)>;
+
+		// settings.deferred is fixed for the renderer's lifetime, the rest can be changed through the setters
+		EngineRenderer(EngineWindow& window, EngineDevice& device, const EngineSwapChain::Settings& settings = {});
+		// Headless, needs a headless device. Renders into offscreen images of the given size through
+		// the same render passes, nothing is presented
+		EngineRenderer(EngineDevice& device, VkExtent2D extent, const EngineSwapChain::Settings& settings = {});
 		~EngineRenderer();
 		EngineRenderer(const EngineRenderer&) = delete;
 		EngineRenderer& operator=(const EngineRenderer&) = delete;
 
 		VkRenderPass GetSwapChainRenderPass() const { return engineSwapChain->getRenderPass(); }
+		VkRenderPass GetDeferredRenderPass() const {
+			assert(IsDeferred() && "The deferred render pass is only built with Settings::deferred");
+			return engineSwapChain->getDeferredRenderPass();
+		}
+		bool IsDeferred() const { return swapChainSettings.deferred; }
 		bool IsFrameInProgress() const { return isFrameStarted; }
 		float GetAspectRatio() const { return engineSwapChain->extentAspectRatio(); }
+		VkExtent2D GetSwapChainExtent() const { return engineSwapChain->getSwapChainExtent(); }
 		VkCommandBuffer GetCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame is not in progress");
 			return commandBuffers[currentFrameIndex];
 		}
 
+		// Filters redundant state on the current command buffer, reset by every BeginFrame
+		EngineCommandRecorder& GetCommandRecorder() {
+			assert(isFrameStarted && "Cannot get command recorder when frame is not in progress");
+			return commandRecorder;
+		}
+
+		// Input attachments (albedo, normal, depth) of the current image's G-buffer for the lighting subpass
+		VkDescriptorSet GetGBufferDescriptorSet() const {
+			assert(isFrameStarted && "Cannot get G-buffer descriptor set when frame is not in progress");
+			assert(IsDeferred() && "The G-buffer is only built with Settings::deferred");
+			return gBufferDescriptorSets[currentImageIndex];
+		}
+
 		int GetFrameIndex() const { 
 			assert(isFrameStarted && "Cannot get command buffer when frame is not in progress");
 			return currentFrameIndex; 
 		}
 
+		// Both recreate the swap chain at the next BeginFrame, frames in flight is clamped to 1 - MAX_FRAMES_IN_FLIGHT
+		void SetPresentMode(VkPresentModeKHR presentMode);
+		void SetFramesInFlight(uint32_t framesInFlight);
+		// The mode in use, the requested one may be unsupported
+		VkPresentModeKHR GetPresentMode() const { return engineSwapChain->getPresentMode(); }
+		// Whether the surface reports the mode, unsupported requests fall back to FIFO
+		bool IsPresentModeSupported(VkPresentModeKHR presentMode);
+		uint32_t GetFramesInFlight() const { return swapChainSettings.framesInFlight; }
+		void SetFrameReleaseCallback(FrameReleaseCallback callback) { frameReleaseCallback = std::move(callback); }
+		const LatencyStats& GetLatencyStats() const { return latencyStats; }
+		void ResetLatencyStats() { latencyStats = {}; }
+
+		bool IsHeadless() const { return engineWindow == nullptr; }
+		// Headless only, resizes the offscreen images at the next BeginFrame
+		void SetExtent(VkExtent2D extent);
+		// Headless only. Every frame's color image is copied out and handed to callback once the GPU
+		// finished it, from a later BeginFrame or FlushReadbacks. An empty callback stops the copies and
+		// delivers the pending ones first
+		void SetReadbackCallback(ReadbackCallback callback);
+		// Waits for all submitted frames and delivers their readbacks
+		void FlushReadbacks() { engineDevice.timeline().Drain(); }
+
 
 		VkCommandBuffer	BeginFrame();
 		void EndFrame();
 		void BeginSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		void EndSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// Deferred path: G-buffer subpass first, NextSubpass moves on to lighting, ended by EndSwapChainRenderPass
+		void BeginDeferredRenderPass(VkCommandBuffer commandBuffer);
+		void NextSubpass(VkCommandBuffer commandBuffer);
 
 	private:
+		void init();
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapchain();
+		void createGBufferDescriptorSets();
+		void invalidateGBufferDescriptorSets(EngineSwapChain& swapChain);
+		void releaseDroppedFrames(EngineSwapChain& oldSwapChain);
+		void sampleLatency();
+		void recordReadback(VkCommandBuffer commandBuffer);
+		void beginRenderPass(
+			VkCommandBuffer commandBuffer, 
+			VkRenderPass renderPass, 
+			VkFramebuffer framebuffer, 
+			const std::vector<VkClearValue>& clearValues);
 
-		EngineWindow& engineWindow;
+		// Null when headless
+		EngineWindow* engineWindow = nullptr;
 		EngineDevice& engineDevice;
 		std::unique_ptr<EngineSwapChain> engineSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
+		EngineCommandRecorder commandRecorder;
+
+		// Must match set 2 of the deferred lighting shaders, null unless deferred
+		std::unique_ptr<EngineDescriptorSetLayout> gBufferSetLayout;
+		EngineDescriptorAllocator gBufferAllocator;
+		// Keyed by the G-buffer views, sets of a replaced swap chain are recycled for the new one
+		EngineDescriptorSetCache gBufferSetCache;
+		std::vector<VkDescriptorSet> gBufferDescriptorSets;
+
+		// Set by a suboptimal present or a resize, carried out by BeginFrame once the size settles
+		bool swapchainRecreatePending{ false };
+		VkExtent2D pendingExtent{};
+		EngineSwapChain::Settings swapChainSettings{};
+		// Applied without waiting for the size to settle
+		bool settingsChanged{ false };
+		FrameReleaseCallback frameReleaseCallback{};
+
+		// Per frame slot, timeline value 0 once the frame's latency was sampled. The present id is 0
+		// without present wait support, the frame then samples its completion
+		std::array<std::chrono::steady_clock::time_point, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> frameStartTimes{};
+		std::array<uint64_t, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> frameLatencyValues{};
+		std::array<uint64_t, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> framePresentIds{};
+		LatencyStats latencyStats{};
+
+		VkExtent2D offscreenExtent{};
+		ReadbackCallback readbackCallback{};
+		// Per frame slot, reused once the slot's previous frame was delivered
+		std::array<std::unique_ptr<EngineBuffer>, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> readbackBuffers{};
+		// Readbacks submitted but not delivered yet, they read from readbackBuffers
+		uint32_t pendingReadbacks = 0;
+		uint64_t frameNumber = 0;
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex{ 0 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Engine {
+
+	// On-disk layout of the SPIR-V bundle written by tools/shader_bundler.cpp:
+	// [ShaderBundleHeader][ShaderBundleEntry * entryCount][names][SPIR-V blobs]
+	// Offsets are from the start of the file and every SPIR-V blob starts on a 4 byte boundary
+	// so it can be handed to vkCreateShaderModule straight from the mapping.
+	constexpr uint32_t SHADER_BUNDLE_MAGIC = 0x42565053; // "SPVB"
+	constexpr uint32_t SHADER_BUNDLE_VERSION = 1;
+
+	struct ShaderBundleHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct ShaderBundleEntry {
+		uint32_t nameOffset; // path relative to the engine dir, ex: "shaders/simple_shader.vert.spv"
+		uint32_t nameSize;
+		uint32_t codeOffset;
+		uint32_t codeSize;
+	};
+}
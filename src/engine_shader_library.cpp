@@ -0,0 +1,232 @@
+#include "engine_shader_library.hpp"
+#include "engine_shader_bundle.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace Engine {
+
+	// *************** Shader Module *********************
+
+	EngineShaderModule::EngineShaderModule(EngineDevice& device, const uint32_t* code, size_t codeSize)
+		: engineDevice(device) {
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = codeSize;
+		createInfo.pCode = code;
+
+		if (vkCreateShaderModule(engineDevice.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module");
+		}
+	}
+
+	EngineShaderModule::~EngineShaderModule() {
+		vkDestroyShaderModule(engineDevice.device(), shaderModule, nullptr);
+	}
+
+	// *************** Shader Library *********************
+
+	EngineShaderLibrary::EngineShaderLibrary(EngineDevice& device, const std::string& bundlePath)
+		: engineDevice(device) {
+		mapBundle(ENGINE_DIR + bundlePath);
+		if (HasBundle()) {
+			readBundleIndex(bundlePath);
+		}
+		else {
+			std::cout << "Shader bundle not found, loading loose SPIR-V files" << std::endl;
+		}
+	}
+
+	EngineShaderLibrary::~EngineShaderLibrary() {
+		unmapBundle();
+	}
+
+	std::shared_ptr<EngineShaderModule> EngineShaderLibrary::Acquire(const std::string& filePath) {
+		std::lock_guard<std::mutex> lock(libraryMutex);
+
+		auto cached = modules.find(filePath);
+		if (cached != modules.end()) {
+			if (auto module = cached->second.lock())
+				return module;
+		}
+
+		std::shared_ptr<EngineShaderModule> module;
+		if (auto entry = findBundleEntry(filePath)) {
+			module = std::make_shared<EngineShaderModule>(engineDevice, entry->code, entry->codeSize);
+		}
+		else {
+			size_t codeSize = 0;
+			auto code = readLooseFile(filePath, codeSize);
+			module = std::make_shared<EngineShaderModule>(engineDevice, code.data(), codeSize);
+		}
+		modules[filePath] = module;
+		return module;
+	}
+
+	ShaderReflection EngineShaderLibrary::Reflect(const std::string& filePath) {
+		std::lock_guard<std::mutex> lock(libraryMutex);
+
+		if (auto entry = findBundleEntry(filePath))
+			return ReflectSpirv(entry->code, entry->codeSize);
+
+		size_t codeSize = 0;
+		auto code = readLooseFile(filePath, codeSize);
+		return ReflectSpirv(code.data(), codeSize);
+	}
+
+	const EngineShaderLibrary::BundleEntry* EngineShaderLibrary::findBundleEntry(const std::string& filePath) const {
+		auto entry = bundleEntries.find(filePath);
+		if (entry == bundleEntries.end() || staleBundleEntries.count(filePath) != 0)
+			return nullptr;
+		return &entry->second;
+	}
+
+	void EngineShaderLibrary::Invalidate(const std::string& filePath) {
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		modules.erase(filePath);
+		staleBundleEntries.insert(filePath);
+	}
+
+	std::vector<uint32_t> EngineShaderLibrary::readLooseFile(const std::string& filePath, size_t& codeSize) {
+		std::string enginePath = ENGINE_DIR + filePath;
+		std::ifstream file{ enginePath, std::ios::ate | std::ios::binary };
+
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open file: " + enginePath);
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+
+		// uint32_t storage keeps the code aligned the way vkCreateShaderModule expects
+		std::vector<uint32_t> buffer((fileSize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+		file.close();
+
+		codeSize = fileSize;
+		return buffer;
+	}
+
+	void EngineShaderLibrary::readBundleIndex(const std::string& bundlePath) {
+		auto fail = [&](const char* reason) {
+			unmapBundle();
+			throw std::runtime_error("Invalid shader bundle " + bundlePath + ": " + reason);
+		};
+
+		if (mappedSize < sizeof(ShaderBundleHeader))
+			fail("file too small");
+
+		auto header = reinterpret_cast<const ShaderBundleHeader*>(mappedData);
+		if (header->magic != SHADER_BUNDLE_MAGIC)
+			fail("bad magic");
+		if (header->version != SHADER_BUNDLE_VERSION)
+			fail("unsupported version");
+		if (sizeof(ShaderBundleHeader) + header->entryCount * sizeof(ShaderBundleEntry) > mappedSize)
+			fail("truncated index");
+
+		auto entries = reinterpret_cast<const ShaderBundleEntry*>(mappedData + sizeof(ShaderBundleHeader));
+		for (uint32_t i = 0; i < header->entryCount; i++) {
+			auto& entry = entries[i];
+			if (static_cast<size_t>(entry.nameOffset) + entry.nameSize > mappedSize ||
+				static_cast<size_t>(entry.codeOffset) + entry.codeSize > mappedSize)
+				fail("entry out of bounds");
+			if (entry.codeOffset % sizeof(uint32_t) != 0 || entry.codeSize % sizeof(uint32_t) != 0)
+				fail("misaligned SPIR-V");
+
+			std::string name{ mappedData + entry.nameOffset, entry.nameSize };
+			bundleEntries[name] = BundleEntry{
+				reinterpret_cast<const uint32_t*>(mappedData + entry.codeOffset),
+				entry.codeSize
+			};
+		}
+		std::cout << "Shader bundle: " << header->entryCount << " shaders" << std::endl;
+	}
+
+#ifdef _WIN32
+	void EngineShaderLibrary::mapBundle(const std::string& bundlePath) {
+		HANDLE file = CreateFileA(
+			bundlePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return;
+		}
+
+		fileHandle = file;
+		mappingHandle = mapping;
+		mappedData = static_cast<const char*>(view);
+		mappedSize = static_cast<size_t>(size.QuadPart);
+	}
+
+	void EngineShaderLibrary::unmapBundle() {
+		if (mappedData == nullptr)
+			return;
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		mappedData = nullptr;
+		mappedSize = 0;
+		bundleEntries.clear();
+	}
+#else
+	void EngineShaderLibrary::mapBundle(const std::string& bundlePath) {
+		int fd = open(bundlePath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat fileStat {};
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			close(fd);
+			return;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping stays valid after the descriptor is closed
+		close(fd);
+		if (view == MAP_FAILED)
+			return;
+
+		mappedData = static_cast<const char*>(view);
+		mappedSize = static_cast<size_t>(fileStat.st_size);
+	}
+
+	void EngineShaderLibrary::unmapBundle() {
+		if (mappedData == nullptr)
+			return;
+		munmap(const_cast<char*>(mappedData), mappedSize);
+		mappedData = nullptr;
+		mappedSize = 0;
+		bundleEntries.clear();
+	}
+#endif
+}
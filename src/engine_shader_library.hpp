@@ -0,0 +1,83 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_shader_reflection.hpp"
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+
+	class EngineShaderModule {
+	public:
+		EngineShaderModule(EngineDevice& device, const uint32_t* code, size_t codeSize);
+		~EngineShaderModule();
+
+		EngineShaderModule(const EngineShaderModule&) = delete;
+		EngineShaderModule& operator=(const EngineShaderModule&) = delete;
+
+		VkShaderModule GetShaderModule() const { return shaderModule; }
+
+	private:
+		EngineDevice& engineDevice;
+		VkShaderModule shaderModule;
+	};
+
+	// Hands out one VkShaderModule per SPIR-V file, shared between every pipeline that uses it.
+	// Modules are looked up in a memory-mapped bundle first and fall back to loose .spv files,
+	// they are destroyed once the last pipeline holding them releases its reference
+	class EngineShaderLibrary {
+	public:
+		static constexpr const char* DEFAULT_BUNDLE_PATH = "shaders/shaders.spvpack";
+
+		EngineShaderLibrary(EngineDevice& device, const std::string& bundlePath = DEFAULT_BUNDLE_PATH);
+		~EngineShaderLibrary();
+
+		EngineShaderLibrary(const EngineShaderLibrary&) = delete;
+		EngineShaderLibrary& operator=(const EngineShaderLibrary&) = delete;
+
+		// Thread safe, pipeline compiler workers acquire modules concurrently
+		std::shared_ptr<EngineShaderModule> Acquire(const std::string& filePath);
+
+		// Drops the cached module so the next Acquire reloads it. The bundle copy is stale from
+		// then on, so the loose .spv file is used for this path. Pipelines keep their old module
+		void Invalidate(const std::string& filePath);
+
+		// Reflects the current SPIR-V for the path, from the bundle or the loose file like Acquire
+		ShaderReflection Reflect(const std::string& filePath);
+
+		bool HasBundle() const { return mappedData != nullptr; }
+
+	private:
+		struct BundleEntry {
+			const uint32_t* code;
+			size_t codeSize;
+		};
+
+		void mapBundle(const std::string& bundlePath);
+		void unmapBundle();
+		void readBundleIndex(const std::string& bundlePath);
+		std::vector<uint32_t> readLooseFile(const std::string& filePath, size_t& codeSize);
+		// Bundle entry for the path unless it was invalidated by a reload, nullptr otherwise
+		const BundleEntry* findBundleEntry(const std::string& filePath) const;
+
+		EngineDevice& engineDevice;
+
+		// Bundle mapping, kept for the lifetime of the library since entries point into it
+		const char* mappedData = nullptr;
+		size_t mappedSize = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+		std::unordered_map<std::string, BundleEntry> bundleEntries;
+
+		std::mutex libraryMutex;
+		std::unordered_map<std::string, std::weak_ptr<EngineShaderModule>> modules;
+		std::set<std::string> staleBundleEntries;
+	};
+}
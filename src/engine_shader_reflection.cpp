@@ -0,0 +1,393 @@
+#include "engine_shader_reflection.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Engine {
+
+	namespace {
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+		constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+		// Opcodes, storage classes and decorations from the SPIR-V specification that reflection needs
+		enum SpirvOp : uint32_t {
+			OpEntryPoint = 15,
+			OpTypeBool = 20,
+			OpTypeInt = 21,
+			OpTypeFloat = 22,
+			OpTypeVector = 23,
+			OpTypeMatrix = 24,
+			OpTypeImage = 25,
+			OpTypeSampler = 26,
+			OpTypeSampledImage = 27,
+			OpTypeArray = 28,
+			OpTypeRuntimeArray = 29,
+			OpTypeStruct = 30,
+			OpTypePointer = 32,
+			OpConstant = 43,
+			OpSpecConstant = 50,
+			OpVariable = 59,
+			OpDecorate = 71,
+			OpMemberDecorate = 72,
+		};
+
+		enum SpirvStorageClass : uint32_t {
+			StorageUniformConstant = 0,
+			StorageInput = 1,
+			StorageUniform = 2,
+			StoragePushConstant = 9,
+			StorageStorageBuffer = 12,
+		};
+
+		enum SpirvDecoration : uint32_t {
+			DecorationBlock = 2,
+			DecorationBufferBlock = 3,
+			DecorationArrayStride = 6,
+			DecorationMatrixStride = 7,
+			DecorationBuiltIn = 11,
+			DecorationLocation = 30,
+			DecorationBinding = 33,
+			DecorationDescriptorSet = 34,
+			DecorationOffset = 35,
+		};
+
+		enum SpirvImageDim : uint32_t {
+			DimBuffer = 5,
+			DimSubpassData = 6,
+		};
+
+		constexpr uint32_t NOT_SET = std::numeric_limits<uint32_t>::max();
+
+		struct SpirvType {
+			uint32_t opcode;
+			// Operands following the result id
+			std::vector<uint32_t> operands;
+		};
+
+		struct SpirvDecorations {
+			uint32_t set = NOT_SET;
+			uint32_t binding = NOT_SET;
+			uint32_t location = NOT_SET;
+			uint32_t arrayStride = 0;
+			bool block = false;
+			bool bufferBlock = false;
+			bool builtIn = false;
+		};
+
+		struct SpirvMember {
+			uint32_t offset = 0;
+			uint32_t matrixStride = 0;
+		};
+
+		struct SpirvVariable {
+			uint32_t pointerType;
+			uint32_t id;
+			uint32_t storageClass;
+		};
+
+		class SpirvModule {
+		public:
+			SpirvModule(const uint32_t* code, size_t wordCount) {
+				if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC)
+					throw std::runtime_error("Invalid SPIR-V: bad header");
+
+				size_t position = SPIRV_HEADER_WORDS;
+				while (position < wordCount) {
+					uint32_t opcode = code[position] & 0xFFFF;
+					uint32_t instructionWords = code[position] >> 16;
+					if (instructionWords == 0 || position + instructionWords > wordCount)
+						throw std::runtime_error("Invalid SPIR-V: truncated instruction");
+					parseInstruction(opcode, code + position + 1, instructionWords - 1);
+					position += instructionWords;
+				}
+			}
+
+			uint32_t executionModel = NOT_SET;
+			std::unordered_map<uint32_t, SpirvType> types;
+			std::unordered_map<uint32_t, uint32_t> constants;
+			std::unordered_map<uint32_t, SpirvDecorations> decorations;
+			std::unordered_map<uint32_t, std::map<uint32_t, SpirvMember>> members;
+			std::vector<SpirvVariable> variables;
+
+			const SpirvType& type(uint32_t id) const {
+				auto it = types.find(id);
+				if (it == types.end())
+					throw std::runtime_error("Invalid SPIR-V: unknown type id");
+				return it->second;
+			}
+
+			const SpirvDecorations& decoration(uint32_t id) const {
+				static const SpirvDecorations none{};
+				auto it = decorations.find(id);
+				return it != decorations.end() ? it->second : none;
+			}
+
+			uint32_t constant(uint32_t id) const {
+				auto it = constants.find(id);
+				if (it == constants.end())
+					throw std::runtime_error("Invalid SPIR-V: array length is not a constant");
+				return it->second;
+			}
+
+			// Size in bytes as laid out in a buffer block, using the explicit strides when decorated
+			uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+				auto& spirvType = type(typeId);
+				auto& ops = spirvType.operands;
+				switch (spirvType.opcode) {
+				case OpTypeBool:
+					return 4;
+				case OpTypeInt:
+				case OpTypeFloat:
+					return ops.at(0) / 8;
+				case OpTypeVector:
+					return ops.at(1) * sizeOf(ops.at(0));
+				case OpTypeMatrix:
+					return ops.at(1) * (matrixStride != 0 ? matrixStride : sizeOf(ops.at(0)));
+				case OpTypeArray: {
+					uint32_t stride = decoration(typeId).arrayStride;
+					return constant(ops.at(1)) * (stride != 0 ? stride : sizeOf(ops.at(0), matrixStride));
+				}
+				case OpTypeRuntimeArray:
+					return 0;
+				case OpTypeStruct: {
+					uint32_t size = 0;
+					auto memberInfo = members.find(typeId);
+					for (uint32_t i = 0; i < ops.size(); i++) {
+						SpirvMember member{};
+						if (memberInfo != members.end() && memberInfo->second.count(i))
+							member = memberInfo->second.at(i);
+						size = std::max(size, member.offset + sizeOf(ops[i], member.matrixStride));
+					}
+					return size;
+				}
+				default:
+					throw std::runtime_error("Invalid SPIR-V: type has no size");
+				}
+			}
+
+		private:
+			void parseInstruction(uint32_t opcode, const uint32_t* ops, uint32_t count) {
+				auto require = [&](uint32_t minimum) {
+					if (count < minimum)
+						throw std::runtime_error("Invalid SPIR-V: missing operands");
+				};
+
+				switch (opcode) {
+				case OpEntryPoint:
+					require(1);
+					// Modules with several entry points are reflected by their first one
+					if (executionModel == NOT_SET)
+						executionModel = ops[0];
+					break;
+				case OpTypeBool:
+				case OpTypeInt:
+				case OpTypeFloat:
+				case OpTypeVector:
+				case OpTypeMatrix:
+				case OpTypeImage:
+				case OpTypeSampler:
+				case OpTypeSampledImage:
+				case OpTypeArray:
+				case OpTypeRuntimeArray:
+				case OpTypeStruct:
+				case OpTypePointer:
+					require(1);
+					types[ops[0]] = SpirvType{ opcode, std::vector<uint32_t>(ops + 1, ops + count) };
+					break;
+				case OpConstant:
+				case OpSpecConstant:
+					require(3);
+					constants[ops[1]] = ops[2];
+					break;
+				case OpVariable:
+					require(3);
+					variables.push_back(SpirvVariable{ ops[0], ops[1], ops[2] });
+					break;
+				case OpDecorate: {
+					require(2);
+					auto& target = decorations[ops[0]];
+					uint32_t literal = count > 2 ? ops[2] : 0;
+					switch (ops[1]) {
+					case DecorationBlock: target.block = true; break;
+					case DecorationBufferBlock: target.bufferBlock = true; break;
+					case DecorationBuiltIn: target.builtIn = true; break;
+					case DecorationArrayStride: target.arrayStride = literal; break;
+					case DecorationLocation: target.location = literal; break;
+					case DecorationBinding: target.binding = literal; break;
+					case DecorationDescriptorSet: target.set = literal; break;
+					}
+					break;
+				}
+				case OpMemberDecorate: {
+					require(3);
+					auto& member = members[ops[0]][ops[1]];
+					uint32_t literal = count > 3 ? ops[3] : 0;
+					if (ops[2] == DecorationOffset)
+						member.offset = literal;
+					else if (ops[2] == DecorationMatrixStride)
+						member.matrixStride = literal;
+					else if (ops[2] == DecorationBuiltIn)
+						decorations[ops[0]].builtIn = true;
+					break;
+				}
+				}
+			}
+		};
+
+		VkShaderStageFlagBits stageFromExecutionModel(uint32_t executionModel) {
+			switch (executionModel) {
+			case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+			case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: throw std::runtime_error("Invalid SPIR-V: unsupported execution model");
+			}
+		}
+
+		VkDescriptorType descriptorTypeOf(const SpirvModule& module, uint32_t typeId, uint32_t storageClass) {
+			auto& spirvType = module.type(typeId);
+			if (storageClass == StorageStorageBuffer)
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			if (storageClass == StorageUniform) {
+				// Pre 1.3 SPIR-V marks storage buffers as BufferBlock in the Uniform storage class
+				return module.decoration(typeId).bufferBlock ?
+					VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+
+			switch (spirvType.opcode) {
+			case OpTypeSampler:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case OpTypeSampledImage:
+				return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case OpTypeImage: {
+				// Operands: sampled type, dim, depth, arrayed, ms, sampled
+				uint32_t dim = spirvType.operands.at(1);
+				uint32_t sampled = spirvType.operands.at(5);
+				if (dim == DimSubpassData)
+					return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				if (dim == DimBuffer)
+					return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			default:
+				throw std::runtime_error("Invalid SPIR-V: unsupported descriptor type");
+			}
+		}
+
+		VkFormat vertexFormatOf(const SpirvModule& module, uint32_t typeId) {
+			auto& spirvType = module.type(typeId);
+			uint32_t componentCount = 1;
+			uint32_t componentType = typeId;
+			if (spirvType.opcode == OpTypeVector) {
+				componentType = spirvType.operands.at(0);
+				componentCount = spirvType.operands.at(1);
+			}
+
+			auto& component = module.type(componentType);
+			if (component.operands.at(0) != 32 || componentCount < 1 || componentCount > 4)
+				return VK_FORMAT_UNDEFINED;
+
+			static const VkFormat floatFormats[] = {
+				VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static const VkFormat sintFormats[] = {
+				VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static const VkFormat uintFormats[] = {
+				VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+			if (component.opcode == OpTypeFloat)
+				return floatFormats[componentCount - 1];
+			if (component.opcode == OpTypeInt)
+				return component.operands.at(1) != 0 ? sintFormats[componentCount - 1] : uintFormats[componentCount - 1];
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	ShaderReflection ReflectSpirv(const uint32_t* code, size_t codeSize) {
+		SpirvModule module{ code, codeSize / sizeof(uint32_t) };
+		if (module.executionModel == NOT_SET)
+			throw std::runtime_error("Invalid SPIR-V: no entry point");
+
+		ShaderReflection reflection{};
+		reflection.stage = stageFromExecutionModel(module.executionModel);
+
+		for (auto& variable : module.variables) {
+			auto& pointer = module.type(variable.pointerType);
+			if (pointer.opcode != OpTypePointer)
+				throw std::runtime_error("Invalid SPIR-V: variable is not a pointer");
+			uint32_t typeId = pointer.operands.at(1);
+			auto& decoration = module.decoration(variable.id);
+
+			switch (variable.storageClass) {
+			case StorageUniformConstant:
+			case StorageUniform:
+			case StorageStorageBuffer: {
+				if (decoration.binding == NOT_SET)
+					break;
+
+				// Arrays of descriptors, the element type decides the descriptor type
+				uint32_t descriptorCount = 1;
+				auto* elementType = &module.type(typeId);
+				while (elementType->opcode == OpTypeArray || elementType->opcode == OpTypeRuntimeArray) {
+					descriptorCount = elementType->opcode == OpTypeArray ?
+						descriptorCount * module.constant(elementType->operands.at(1)) : 0;
+					typeId = elementType->operands.at(0);
+					elementType = &module.type(typeId);
+				}
+
+				ReflectedDescriptorBinding binding{};
+				binding.set = decoration.set != NOT_SET ? decoration.set : 0;
+				binding.binding = decoration.binding;
+				binding.descriptorType = descriptorTypeOf(module, typeId, variable.storageClass);
+				binding.descriptorCount = descriptorCount;
+				reflection.descriptorBindings.push_back(binding);
+				break;
+			}
+			case StoragePushConstant: {
+				auto& block = module.type(typeId);
+				uint32_t begin = std::numeric_limits<uint32_t>::max();
+				auto memberInfo = module.members.find(typeId);
+				for (uint32_t i = 0; i < block.operands.size(); i++) {
+					uint32_t offset = 0;
+					if (memberInfo != module.members.end() && memberInfo->second.count(i))
+						offset = memberInfo->second.at(i).offset;
+					begin = std::min(begin, offset);
+				}
+				reflection.pushConstantOffset = block.operands.empty() ? 0 : begin;
+				reflection.pushConstantSize = module.sizeOf(typeId) - reflection.pushConstantOffset;
+				break;
+			}
+			case StorageInput: {
+				if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || decoration.builtIn ||
+					module.decoration(typeId).builtIn || decoration.location == NOT_SET)
+					break;
+
+				// Matrices take one location per column
+				auto& inputType = module.type(typeId);
+				uint32_t columns = 1;
+				if (inputType.opcode == OpTypeMatrix) {
+					columns = inputType.operands.at(1);
+					typeId = inputType.operands.at(0);
+				}
+				for (uint32_t column = 0; column < columns; column++) {
+					reflection.vertexInputs.push_back(
+						ReflectedVertexInput{ decoration.location + column, vertexFormatOf(module, typeId) });
+				}
+				break;
+			}
+			}
+		}
+
+		std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(),
+			[](const ReflectedDescriptorBinding& a, const ReflectedDescriptorBinding& b) {
+				return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+			});
+		std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+			[](const ReflectedVertexInput& a, const ReflectedVertexInput& b) { return a.location < b.location; });
+		return reflection;
+	}
+}
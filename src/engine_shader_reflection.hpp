@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Engine {
+
+	struct ReflectedDescriptorBinding {
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType descriptorType;
+		// 0 for runtime sized arrays, the owner of the layout picks the real count
+		uint32_t descriptorCount;
+	};
+
+	struct ReflectedVertexInput {
+		uint32_t location;
+		VkFormat format;
+	};
+
+	// Interface of one SPIR-V module, everything a pipeline layout and vertex input need
+	struct ShaderReflection {
+		VkShaderStageFlagBits stage{};
+		std::vector<ReflectedDescriptorBinding> descriptorBindings{};
+		// Vertex stage only, builtins like gl_VertexIndex are skipped
+		std::vector<ReflectedVertexInput> vertexInputs{};
+		// Byte range of the push constant block, size is 0 when the stage declares none
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0;
+	};
+
+	// Parses the SPIR-V binary directly, throws std::runtime_error on malformed modules.
+	// Specialization constants used as array sizes are read with their default values
+	ShaderReflection ReflectSpirv(const uint32_t* code, size_t codeSize);
+}
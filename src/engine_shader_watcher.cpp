@@ -0,0 +1,110 @@
+#include "engine_shader_watcher.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <unordered_map>
+#endif
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace Engine {
+
+	static bool isSpirvFile(const std::string& fileName) {
+		const std::string extension = ".spv";
+		return fileName.size() > extension.size() &&
+			fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	EngineShaderWatcher::EngineShaderWatcher(const std::string& directory) : directory(directory) {
+		watchThread = std::thread([this]() { watchLoop(); });
+	}
+
+	EngineShaderWatcher::~EngineShaderWatcher() {
+		stopping = true;
+		watchThread.join();
+	}
+
+	std::vector<std::string> EngineShaderWatcher::PollChanges() {
+		std::lock_guard<std::mutex> lock(changesMutex);
+		std::vector<std::string> result(changes.begin(), changes.end());
+		changes.clear();
+		return result;
+	}
+
+	void EngineShaderWatcher::pushChange(const std::string& fileName) {
+		if (!isSpirvFile(fileName))
+			return;
+		std::lock_guard<std::mutex> lock(changesMutex);
+		changes.insert(directory + "/" + fileName);
+	}
+
+#ifdef __linux__
+	void EngineShaderWatcher::watchLoop() {
+		std::string watchPath = ENGINE_DIR + directory;
+		int fd = inotify_init1(IN_NONBLOCK);
+		if (fd < 0) {
+			std::cerr << "Shader watcher: inotify unavailable, hot reload disabled" << std::endl;
+			return;
+		}
+		// Compilers either rewrite the file in place or move a temporary over it
+		if (inotify_add_watch(fd, watchPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			std::cerr << "Shader watcher: cannot watch " << watchPath << std::endl;
+			close(fd);
+			return;
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		while (!stopping) {
+			pollfd pollInfo{ fd, POLLIN, 0 };
+			// Short timeout so the destructor doesn't wait long on join
+			if (poll(&pollInfo, 1, 100) <= 0)
+				continue;
+
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length;) {
+				auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				if (event->len > 0)
+					pushChange(event->name);
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+		close(fd);
+	}
+#else
+	void EngineShaderWatcher::watchLoop() {
+		namespace fs = std::filesystem;
+		fs::path watchPath = ENGINE_DIR + directory;
+		std::unordered_map<std::string, fs::file_time_type> writeTimes;
+		bool firstScan = true;
+
+		while (!stopping) {
+			std::error_code error;
+			for (auto& entry : fs::directory_iterator(watchPath, error)) {
+				auto fileName = entry.path().filename().string();
+				if (!isSpirvFile(fileName))
+					continue;
+				auto writeTime = entry.last_write_time(error);
+				if (error)
+					continue;
+				auto it = writeTimes.find(fileName);
+				if (it == writeTimes.end() || it->second != writeTime) {
+					writeTimes[fileName] = writeTime;
+					if (!firstScan)
+						pushChange(fileName);
+				}
+			}
+			firstScan = false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
+	}
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine {
+
+	// Watches a shader directory for rewritten .spv files on a background thread.
+	// Uses inotify on Linux and falls back to polling modification times elsewhere
+	class EngineShaderWatcher {
+	public:
+		// directory is relative to the engine dir, reported paths keep that prefix ex: "shaders/x.vert.spv"
+		EngineShaderWatcher(const std::string& directory = "shaders");
+		~EngineShaderWatcher();
+
+		EngineShaderWatcher(const EngineShaderWatcher&) = delete;
+		EngineShaderWatcher& operator=(const EngineShaderWatcher&) = delete;
+
+		// Returns and clears the set of shaders changed since the last call, never blocks
+		std::vector<std::string> PollChanges();
+
+	private:
+		void watchLoop();
+		void pushChange(const std::string& fileName);
+
+		std::string directory;
+		std::thread watchThread;
+		std::atomic<bool> stopping{ false };
+
+		std::mutex changesMutex;
+		std::set<std::string> changes;
+	};
+}
@@ -1,7 +1,10 @@
 #include "engine_swap_chain.hpp"
+#include "engine_profiler.hpp"
 
 // std
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,72 +14,111 @@
 
 namespace Engine {
 
-    EngineSwapChain::EngineSwapChain(EngineDevice &deviceRef, VkExtent2D extent)
-        : device{deviceRef}, windowExtent{extent} {
+    EngineSwapChain::EngineSwapChain(
+        EngineDevice& deviceRef, VkExtent2D extent, const Settings& settings, std::shared_ptr<EngineSwapChain> previous)
+        : device{ deviceRef }, windowExtent{ extent }, settings{ settings }, oldSwapChain{ previous } {
+        assert(settings.framesInFlight >= 1 && settings.framesInFlight <= MAX_FRAMES_IN_FLIGHT &&
+            "Frames in flight out of range");
         init();
-    }
 
-    EngineSwapChain::EngineSwapChain(EngineDevice& deviceRef, VkExtent2D extent, std::shared_ptr<EngineSwapChain> previous)
-        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain {previous} {
-        init();
+        if (oldSwapChain != nullptr) {
+            // Frames submitted through the old swap chain still guard their frame slots
+            frameTimelineValues = oldSwapChain->frameTimelineValues;
 
-        // clean up old swap chain since it's no longer needed
-        oldSwapChain = nullptr;
+            // clean up old swap chain since it's no longer needed
+            oldSwapChain = nullptr;
+        }
     }
 
     void EngineSwapChain::init() {
-        createSwapChain();
+        if (isOffscreen())
+            createOffscreenImages();
+        else
+            createSwapChain();
         createImageViews();
         createRenderPass();
         createDepthResources();
         createFramebuffers();
+        if (settings.deferred) {
+          createGBufferResources();
+          createDeferredRenderPass();
+          createDeferredFramebuffers();
+        }
         createSyncObjects();
     }
 
     EngineSwapChain::~EngineSwapChain() {
+      // Frames in flight may still render to or present from this swap chain, everything is
+      // released through the deletion queue once the GPU is past them
+      auto &deletionQueue = device.deletionQueue();
+      for (auto framebuffer : swapChainFramebuffers) {
+        deletionQueue.DestroyFramebuffer(framebuffer);
+      }
+      for (auto framebuffer : deferredFramebuffers) {
+        deletionQueue.DestroyFramebuffer(framebuffer);
+      }
+      // Null when the next swap chain took them over
+      if (renderPass != VK_NULL_HANDLE) {
+        deletionQueue.DestroyRenderPass(renderPass);
+      }
+      if (deferredRenderPass != VK_NULL_HANDLE) {
+        deletionQueue.DestroyRenderPass(deferredRenderPass);
+      }
+
       for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(device.device(), imageView, nullptr);
+        deletionQueue.DestroyImageView(imageView);
       }
       swapChainImageViews.clear();
-
-      if (swapChain != nullptr) {
-        vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
-        swapChain = nullptr;
+      for (size_t i = 0; i < offscreenImageMemorys.size(); i++) {
+        deletionQueue.DestroyImage(swapChainImages[i]);
+        deletionQueue.FreeMemory(offscreenImageMemorys[i]);
       }
 
       for (int i = 0; i < depthImages.size(); i++) {
-        vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-        vkDestroyImage(device.device(), depthImages[i], nullptr);
-        vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        deletionQueue.DestroyImageView(depthImageViews[i]);
+        deletionQueue.DestroyImage(depthImages[i]);
+        deletionQueue.FreeMemory(depthImageMemorys[i]);
       }
-
-      for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+      for (auto* attachments : {&gBufferAlbedo, &gBufferNormal}) {
+        for (auto& attachment : *attachments) {
+          deletionQueue.DestroyImageView(attachment.view);
+          deletionQueue.DestroyImage(attachment.image);
+          deletionQueue.FreeMemory(attachment.memory);
+        }
       }
 
-      vkDestroyRenderPass(device.device(), renderPass, nullptr);
+      // After the views of its images
+      if (swapChain != VK_NULL_HANDLE) {
+        deletionQueue.DestroySwapchain(swapChain);
+        swapChain = VK_NULL_HANDLE;
+      }
 
-      // cleanup synchronization objects
+      // Presents wait on renderFinished without the timeline knowing, they are done by the time a
+      // later frame finished
       for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+        deletionQueue.DestroySemaphore(renderFinishedSemaphores[i]);
+        deletionQueue.DestroySemaphore(imageAvailableSemaphores[i]);
       }
     }
 
-    VkResult EngineSwapChain::acquireNextImage(uint32_t *imageIndex) {
-      vkWaitForFences(
-          device.device(),
-          1,
-          &inFlightFences[currentFrame],
-          VK_TRUE,
-          std::numeric_limits<uint64_t>::max());
+    VkResult EngineSwapChain::acquireNextImage(int frameIndex, uint32_t *imageIndex) {
+      // The frame last submitted from this slot has to finish before its resources are reused
+      {
+        ENGINE_PROFILE_ZONE("Wait for frame slot");
+        device.timeline().Wait(frameTimelineValues[frameIndex]);
+      }
 
+      if (isOffscreen()) {
+        *imageIndex = static_cast<uint32_t>(frameIndex);
+        return VK_SUCCESS;
+      }
+
+      ENGINE_PROFILE_ZONE("Acquire image");
       VkResult result = vkAcquireNextImageKHR(
           device.device(),
           swapChain,
           std::numeric_limits<uint64_t>::max(),
-          imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
+          imageAvailableSemaphores[frameIndex],  // must be a not signaled semaphore
           VK_NULL_HANDLE,
           imageIndex);
 
@@ -84,16 +126,29 @@ namespace Engine {
     }
 
     VkResult EngineSwapChain::submitCommandBuffers(
-        const VkCommandBuffer *buffers, uint32_t *imageIndex) {
-      if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+        int frameIndex, const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+      // An image can come back while the frame of another slot still renders to it
+      {
+        ENGINE_PROFILE_ZONE("Wait for image");
+        device.timeline().Wait(imageTimelineValues[*imageIndex]);
       }
-      imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
       VkSubmitInfo submitInfo = {};
       submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-      VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+      if (isOffscreen()) {
+        // Nothing to wait for or present, the timeline alone tracks the frame
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = buffers;
+        ENGINE_PROFILE_ZONE("Queue submit");
+        uint64_t timelineValue = device.timeline().Submit(device.graphicsQueue(), submitInfo);
+        device.deletionQueue().Stamp(timelineValue);
+        frameTimelineValues[frameIndex] = timelineValue;
+        imageTimelineValues[*imageIndex] = timelineValue;
+        return VK_SUCCESS;
+      }
+
+      VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[frameIndex]};
       VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
       submitInfo.waitSemaphoreCount = 1;
       submitInfo.pWaitSemaphores = waitSemaphores;
@@ -102,15 +157,19 @@ namespace Engine {
       submitInfo.commandBufferCount = 1;
       submitInfo.pCommandBuffers = buffers;
 
-      VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+      VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[frameIndex]};
       submitInfo.signalSemaphoreCount = 1;
       submitInfo.pSignalSemaphores = signalSemaphores;
 
-      vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-      if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-          VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+      uint64_t timelineValue;
+      {
+        ENGINE_PROFILE_ZONE("Queue submit");
+        timelineValue = device.timeline().Submit(device.graphicsQueue(), submitInfo);
       }
+      // Objects dropped while recording this frame live until it finished
+      device.deletionQueue().Stamp(timelineValue);
+      frameTimelineValues[frameIndex] = timelineValue;
+      imageTimelineValues[*imageIndex] = timelineValue;
 
       VkPresentInfoKHR presentInfo = {};
       presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -124,22 +183,35 @@ namespace Engine {
 
       presentInfo.pImageIndices = imageIndex;
 
-      auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
-
-      currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+      VkPresentIdKHR presentIdInfo = {};
+      uint64_t presentId = lastPresentId + 1;
+      if (device.supportsPresentWait()) {
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        presentInfo.pNext = &presentIdInfo;
+        lastPresentId = presentId;
+      }
 
-      return result;
+      ENGINE_PROFILE_ZONE("Present");
+      return device.timeline().Present(device.presentQueue(), presentInfo);
     }
 
+    VkResult EngineSwapChain::waitForPresent(uint64_t presentId, uint64_t timeout) {
+      assert(device.supportsPresentWait() && "Present wait isn't enabled");
+      // The swap chain must be externally synchronised, it's only ever presented from this thread
+      return device.waitForPresentKHR(device.device(), swapChain, presentId, timeout);
+    }
 
     void EngineSwapChain::createSwapChain() {
       SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
       VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-      VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+      presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
       VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-      uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+      // One image per frame in flight plus the one on screen
+      uint32_t imageCount = std::max(swapChainSupport.capabilities.minImageCount + 1, settings.framesInFlight + 1);
       if (swapChainSupport.capabilities.maxImageCount > 0 &&
           imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -193,6 +265,38 @@ namespace Engine {
       swapChainExtent = extent;
     }
 
+    void EngineSwapChain::createOffscreenImages() {
+      swapChainImageFormat = OFFSCREEN_COLOR_FORMAT;
+      swapChainExtent = windowExtent;
+      presentMode = settings.presentMode;
+
+      // Acquire hands out the frame slot's image, so one per frame in flight is enough
+      swapChainImages.resize(settings.framesInFlight);
+      offscreenImageMemorys.resize(settings.framesInFlight);
+      for (size_t i = 0; i < swapChainImages.size(); i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = swapChainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(
+            imageInfo,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapChainImages[i],
+            offscreenImageMemorys[i]);
+      }
+    }
+
     void EngineSwapChain::createImageViews() {
       swapChainImageViews.resize(swapChainImages.size());
       for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -214,7 +318,22 @@ namespace Engine {
       }
     }
 
+    // Pipelines and their hot reloads keep using the render pass handles they were built with, so a
+    // recreated swap chain takes the passes over instead of destroying them. Then no handle a
+    // pipeline refers to is ever destroyed and reused while the pipeline lives
+    bool EngineSwapChain::canAdoptRenderPasses() {
+      return oldSwapChain != nullptr &&
+          oldSwapChain->swapChainImageFormat == swapChainImageFormat &&
+          oldSwapChain->swapChainDepthFormat == findDepthFormat();
+    }
+
     void EngineSwapChain::createRenderPass() {
+      if (canAdoptRenderPasses()) {
+        renderPass = oldSwapChain->renderPass;
+        oldSwapChain->renderPass = VK_NULL_HANDLE;
+        return;
+      }
+
       VkAttachmentDescription depthAttachment{};
       depthAttachment.format = findDepthFormat();
       depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -237,7 +356,7 @@ namespace Engine {
       colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
       colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
       colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-      colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+      colorAttachment.finalLayout = colorFinalLayout();
 
       VkAttachmentReference colorAttachmentRef = {};
       colorAttachmentRef.attachment = 0;
@@ -260,6 +379,11 @@ namespace Engine {
       dependency.dstAccessMask =
           VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+      std::vector<VkSubpassDependency> dependencies = {dependency};
+      if (isOffscreen()) {
+        dependencies.push_back(readbackDependency(0));
+      }
+
       std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
       VkRenderPassCreateInfo renderPassInfo = {};
       renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -267,8 +391,8 @@ namespace Engine {
       renderPassInfo.pAttachments = attachments.data();
       renderPassInfo.subpassCount = 1;
       renderPassInfo.pSubpasses = &subpass;
-      renderPassInfo.dependencyCount = 1;
-      renderPassInfo.pDependencies = &dependency;
+      renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+      renderPassInfo.pDependencies = dependencies.data();
 
       if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
@@ -322,6 +446,10 @@ namespace Engine {
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        // Read back as an input attachment by the deferred lighting subpass
+        if (settings.deferred) {
+          imageInfo.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        }
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -349,25 +477,204 @@ namespace Engine {
       }
     }
 
+    void EngineSwapChain::createGBufferResources() {
+      // Transient attachments never leave tile memory on tiled GPUs, back them lazily when possible
+      VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      if (device.hasMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+        memoryProperties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+      }
+
+      auto createAttachment = [&](VkFormat format, GBufferAttachment &attachment) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(imageInfo, memoryProperties, attachment.image, attachment.memory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = attachment.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &attachment.view) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create G-buffer image view!");
+        }
+      };
+
+      gBufferAlbedo.resize(imageCount());
+      gBufferNormal.resize(imageCount());
+      for (size_t i = 0; i < imageCount(); i++) {
+        createAttachment(GBUFFER_ALBEDO_FORMAT, gBufferAlbedo[i]);
+        createAttachment(GBUFFER_NORMAL_FORMAT, gBufferNormal[i]);
+      }
+    }
+
+    void EngineSwapChain::createDeferredRenderPass() {
+      if (canAdoptRenderPasses() && oldSwapChain->deferredRenderPass != VK_NULL_HANDLE) {
+        deferredRenderPass = oldSwapChain->deferredRenderPass;
+        oldSwapChain->deferredRenderPass = VK_NULL_HANDLE;
+        return;
+      }
+
+      // 0: swap chain image, 1: depth, 2: albedo, 3: normal
+      std::array<VkAttachmentDescription, 4> attachments{};
+
+      attachments[0].format = getSwapChainImageFormat();
+      attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+      attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      attachments[0].finalLayout = colorFinalLayout();
+
+      attachments[1].format = swapChainDepthFormat;
+      attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+      attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+      // G-buffer contents are consumed inside the render pass and never stored
+      for (size_t i = 2; i < attachments.size(); i++) {
+        attachments[i].format = i == 2 ? GBUFFER_ALBEDO_FORMAT : GBUFFER_NORMAL_FORMAT;
+        attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      }
+
+      // Geometry subpass
+      std::array<VkAttachmentReference, 2> gBufferWriteRefs = {{
+          {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+          {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}}};
+      VkAttachmentReference depthWriteRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+      // Lighting subpass, depth stays bound read-only so blended sprites can still depth test
+      VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      VkAttachmentReference depthReadRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+      std::array<VkAttachmentReference, 3> gBufferReadRefs = {{
+          {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+          {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+          {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}}};
+
+      std::array<VkSubpassDescription, 2> subpasses = {};
+      subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gBufferWriteRefs.size());
+      subpasses[0].pColorAttachments = gBufferWriteRefs.data();
+      subpasses[0].pDepthStencilAttachment = &depthWriteRef;
+
+      subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[1].colorAttachmentCount = 1;
+      subpasses[1].pColorAttachments = &colorRef;
+      subpasses[1].pDepthStencilAttachment = &depthReadRef;
+      subpasses[1].inputAttachmentCount = static_cast<uint32_t>(gBufferReadRefs.size());
+      subpasses[1].pInputAttachments = gBufferReadRefs.data();
+
+      std::vector<VkSubpassDependency> dependencies(2);
+      dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+      dependencies[0].dstSubpass = 0;
+      dependencies[0].srcStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependencies[0].srcAccessMask = 0;
+      dependencies[0].dstStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependencies[0].dstAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+      // By region keeps the G-buffer reads on tile
+      dependencies[1].srcSubpass = 0;
+      dependencies[1].dstSubpass = 1;
+      dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      dependencies[1].srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      dependencies[1].dstStageMask =
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependencies[1].dstAccessMask =
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+      dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+      if (isOffscreen()) {
+        dependencies.push_back(readbackDependency(1));
+      }
+
+      VkRenderPassCreateInfo renderPassInfo = {};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+      renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+      renderPassInfo.pAttachments = attachments.data();
+      renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+      renderPassInfo.pSubpasses = subpasses.data();
+      renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+      renderPassInfo.pDependencies = dependencies.data();
+
+      if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &deferredRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create deferred render pass!");
+      }
+    }
+
+    void EngineSwapChain::createDeferredFramebuffers() {
+      deferredFramebuffers.resize(imageCount());
+      for (size_t i = 0; i < imageCount(); i++) {
+        std::array<VkImageView, 4> attachments = {
+            swapChainImageViews[i], depthImageViews[i], gBufferAlbedo[i].view, gBufferNormal[i].view};
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = deferredRenderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = swapChainExtent.width;
+        framebufferInfo.height = swapChainExtent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(
+                device.device(),
+                &framebufferInfo,
+                nullptr,
+                &deferredFramebuffers[i]) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create deferred framebuffer!");
+        }
+      }
+    }
+
     void EngineSwapChain::createSyncObjects() {
       imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
       renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-      inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-      imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+      frameTimelineValues.resize(MAX_FRAMES_IN_FLIGHT, 0);
+      imageTimelineValues.resize(imageCount(), 0);
 
       VkSemaphoreCreateInfo semaphoreInfo = {};
       semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-      VkFenceCreateInfo fenceInfo = {};
-      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-      fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
       for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                 VK_SUCCESS ||
             vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-                VK_SUCCESS ||
-            vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                VK_SUCCESS) {
           throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
       }
@@ -388,25 +695,30 @@ namespace Engine {
     VkPresentModeKHR EngineSwapChain::chooseSwapPresentMode(
         const std::vector<VkPresentModeKHR> &availablePresentModes) {
       for (const auto &availablePresentMode : availablePresentModes) {
-        // Not leaving the GPU idle
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-          std::cout << "Present mode: Mailbox" << std::endl;
+        if (availablePresentMode == settings.presentMode) {
           return availablePresentMode;
         }
       }
 
-      // for (const auto &availablePresentMode : availablePresentModes) {
-      //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-      //        // Doesn't synchronization with the refresh rate
-      //        std::cout << "Present mode: Immediate" << std::endl;
-      //     return availablePresentMode;
-      //   }
-      // }
-
-      std::cout << "Present mode: V-Sync" << std::endl;
+      // FIFO is the only mode every device supports
       return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    const char *EngineSwapChain::presentModeName(VkPresentModeKHR presentMode) {
+      switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+          return "Immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+          return "Mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+          return "V-Sync";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+          return "Relaxed V-Sync";
+        default:
+          return "Unknown";
+      }
+    }
+
     VkExtent2D EngineSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
       if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
@@ -423,6 +735,22 @@ namespace Engine {
       }
     }
 
+    VkImageLayout EngineSwapChain::colorFinalLayout() {
+      // PRESENT_SRC_KHR needs the swap chain extension, which a headless device doesn't enable
+      return isOffscreen() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+
+    VkSubpassDependency EngineSwapChain::readbackDependency(uint32_t srcSubpass) {
+      VkSubpassDependency dependency = {};
+      dependency.srcSubpass = srcSubpass;
+      dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+      dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      return dependency;
+    }
+
     VkFormat EngineSwapChain::findDepthFormat() {
       return device.findSupportedFormat(
           {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
@@ -14,10 +14,30 @@ namespace Engine {
 
     class EngineSwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-        EngineSwapChain(EngineDevice &deviceRef, VkExtent2D windowExtent);
-        EngineSwapChain(EngineDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<EngineSwapChain> previous);
+        // Per-frame resources are sized for the most frames in flight, Settings picks how many are used
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+        static constexpr int DEFAULT_FRAMES_IN_FLIGHT = 2;
+        // G-buffer of the deferred render pass, normals are stored as n * 0.5 + 0.5
+        static constexpr VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+        static constexpr VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+        // Color images of a headless device, RGBA so read back frames need no swizzle
+        static constexpr VkFormat OFFSCREEN_COLOR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+        struct Settings {
+            // Falls back to FIFO when the surface doesn't support it, ignored when headless
+            VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            // 1 to MAX_FRAMES_IN_FLIGHT, frame indices passed in must be below it
+            uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+            // Builds the G-buffer, the deferred render pass and its framebuffers. Only the deferred
+            // path reads them, the forward path doesn't pay for two more attachments per image
+            bool deferred = false;
+        };
+
+        EngineSwapChain(
+            EngineDevice &deviceRef,
+            VkExtent2D windowExtent,
+            const Settings &settings,
+            std::shared_ptr<EngineSwapChain> previous = nullptr);
         ~EngineSwapChain();
 
         EngineSwapChain(const EngineSwapChain &) = delete;
@@ -25,7 +45,19 @@ namespace Engine {
 
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        // Settings::deferred only. Subpass 0 fills the G-buffer, subpass 1 reads it as input
+        // attachments into the swap chain image
+        VkFramebuffer getDeferredFrameBuffer(int index) { return deferredFramebuffers[index]; }
+        VkRenderPass getDeferredRenderPass() { return deferredRenderPass; }
+        VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+        VkImageView getGBufferAlbedoView(int index) { return gBufferAlbedo[index].view; }
+        VkImageView getGBufferNormalView(int index) { return gBufferNormal[index].view; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        VkImage getImage(int index) { return swapChainImages[index]; }
+        // Headless: one offscreen image per frame in flight, left in TRANSFER_SRC_OPTIMAL by both render
+        // passes so it can be copied out after the pass. Acquire returns the frame's image and submit
+        // doesn't present
+        bool isOffscreen() { return device.isHeadless(); }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -37,8 +69,20 @@ namespace Engine {
         }
         VkFormat findDepthFormat();
 
-        VkResult acquireNextImage(uint32_t *imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+        // frameIndex is the renderer's frame slot, its previous submission is waited for first
+        VkResult acquireNextImage(int frameIndex, uint32_t *imageIndex);
+        VkResult submitCommandBuffers(int frameIndex, const VkCommandBuffer *buffers, uint32_t *imageIndex);
+        // Timeline value of the frame slot's last submission, 0 if it never submitted
+        uint64_t getFrameTimelineValue(int frameIndex) { return frameTimelineValues[frameIndex]; }
+        // Id of the last present on this swap chain, 0 without present wait support
+        uint64_t getLastPresentId() { return lastPresentId; }
+        // VK_SUCCESS once presentId or a later present reached the screen, VK_TIMEOUT until then
+        VkResult waitForPresent(uint64_t presentId, uint64_t timeout);
+
+        const Settings &getSettings() { return settings; }
+        // The mode in use, settings.presentMode may have been unsupported
+        VkPresentModeKHR getPresentMode() { return presentMode; }
+        static const char *presentModeName(VkPresentModeKHR presentMode);
 
         bool CompareSwapFormats(const EngineSwapChain& swapChain) const {
             return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -48,10 +92,15 @@ namespace Engine {
     private:
         void init();
         void createSwapChain();
+        void createOffscreenImages();
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
+        bool canAdoptRenderPasses();
         void createFramebuffers();
+        void createGBufferResources();
+        void createDeferredRenderPass();
+        void createDeferredFramebuffers();
         void createSyncObjects();
 
         // Helper functions
@@ -60,31 +109,49 @@ namespace Engine {
         VkPresentModeKHR chooseSwapPresentMode(
             const std::vector<VkPresentModeKHR> &availablePresentModes);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
+        VkImageLayout colorFinalLayout();
+        // Makes the color writes of srcSubpass visible to a transfer after the render pass
+        VkSubpassDependency readbackDependency(uint32_t srcSubpass);
 
         VkFormat swapChainImageFormat;
         VkFormat swapChainDepthFormat;
         VkExtent2D swapChainExtent;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+
+        struct GBufferAttachment {
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView view;
+        };
+        std::vector<VkFramebuffer> deferredFramebuffers;
+        VkRenderPass deferredRenderPass = VK_NULL_HANDLE;
+        std::vector<GBufferAttachment> gBufferAlbedo;
+        std::vector<GBufferAttachment> gBufferNormal;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
+        // Headless only, the swap chain owns its images
+        std::vector<VkDeviceMemory> offscreenImageMemorys;
 
         EngineDevice &device;
         VkExtent2D windowExtent;
+        Settings settings;
+        VkPresentModeKHR presentMode;
         std::shared_ptr<EngineSwapChain> oldSwapChain;
 
-        VkSwapchainKHR swapChain;
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        std::vector<VkFence> imagesInFlight;
-        size_t currentFrame = 0;
+        // Timeline value of the last submission per frame slot and per image, 0 when never used
+        std::vector<uint64_t> frameTimelineValues;
+        std::vector<uint64_t> imageTimelineValues;
+        uint64_t lastPresentId = 0;
     };
 
 }  // namespace engine
@@ -0,0 +1,128 @@
+#include "engine_timeline.hpp"
+
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace Engine {
+
+	EngineTimeline::EngineTimeline(VkDevice device) : device(device) {
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timeline semaphore!");
+		}
+	}
+
+	EngineTimeline::~EngineTimeline() {
+		std::lock_guard<std::mutex> lock(callbackMutex);
+		assert(completionCallbacks.empty() && "Timeline destroyed with pending callbacks, Drain it first");
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+
+	uint64_t EngineTimeline::Submit(VkQueue queue, const VkSubmitInfo& submitInfo) {
+		assert(submitInfo.pNext == nullptr && "Timeline submissions chain their own pNext");
+		assert(submitInfo.signalSemaphoreCount < MAX_SIGNAL_SEMAPHORES && "Too many signal semaphores");
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		uint64_t value = lastSubmittedValue.load() + 1;
+
+		// Binary semaphores ignore their value
+		VkSemaphore signalSemaphores[MAX_SIGNAL_SEMAPHORES];
+		uint64_t signalValues[MAX_SIGNAL_SEMAPHORES] = {};
+		uint32_t signalCount = submitInfo.signalSemaphoreCount;
+		for (uint32_t i = 0; i < signalCount; i++)
+			signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+		signalSemaphores[signalCount] = semaphore;
+		signalValues[signalCount] = value;
+		signalCount++;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = signalCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo info = submitInfo;
+		info.pNext = &timelineInfo;
+		info.signalSemaphoreCount = signalCount;
+		info.pSignalSemaphores = signalSemaphores;
+		if (vkQueueSubmit(queue, 1, &info, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit to the queue!");
+		}
+
+		lastSubmittedValue.store(value);
+		return value;
+	}
+
+	VkResult EngineTimeline::Present(VkQueue queue, const VkPresentInfoKHR& presentInfo) {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return vkQueuePresentKHR(queue, &presentInfo);
+	}
+
+	void EngineTimeline::raiseCompletedValue(uint64_t value) {
+		uint64_t current = completedValue.load();
+		while (current < value && !completedValue.compare_exchange_weak(current, value)) {}
+	}
+
+	uint64_t EngineTimeline::GetCompletedValue() {
+		uint64_t value = 0;
+		if (vkGetSemaphoreCounterValue(device, semaphore, &value) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to query timeline semaphore!");
+		}
+		raiseCompletedValue(value);
+		return value;
+	}
+
+	void EngineTimeline::Wait(uint64_t value) {
+		if (value <= completedValue.load())
+			return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		if (vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to wait on timeline semaphore!");
+		}
+		raiseCompletedValue(value);
+	}
+
+	void EngineTimeline::OnComplete(uint64_t value, std::function<void()> callback) {
+		std::lock_guard<std::mutex> lock(callbackMutex);
+		completionCallbacks.emplace(value, std::move(callback));
+	}
+
+	void EngineTimeline::Poll() {
+		{
+			std::lock_guard<std::mutex> lock(callbackMutex);
+			if (completionCallbacks.empty())
+				return;
+		}
+
+		uint64_t completed = GetCompletedValue();
+		// Callbacks may register new ones, each is taken off the map and run outside the lock
+		while (true) {
+			std::function<void()> callback;
+			{
+				std::lock_guard<std::mutex> lock(callbackMutex);
+				if (completionCallbacks.empty() || completionCallbacks.begin()->first > completed)
+					return;
+				callback = std::move(completionCallbacks.begin()->second);
+				completionCallbacks.erase(completionCallbacks.begin());
+			}
+			callback();
+		}
+	}
+
+	void EngineTimeline::Drain() {
+		WaitIdle();
+		Poll();
+	}
+}
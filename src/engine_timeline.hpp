@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace Engine {
+
+	// The device's one timeline semaphore. Every submission signals the next value, so frames,
+	// uploads and any other queue work are ordered on a single counter: once value N completed,
+	// every submission up to N did. Replaces per-frame fences and queue idle waits.
+	// Safe to use from any thread. Submit and Present are serialised, which is the external
+	// synchronisation Vulkan requires of the queue. Callbacks run on the thread that polls
+	class EngineTimeline {
+	public:
+		explicit EngineTimeline(VkDevice device);
+		~EngineTimeline();
+
+		EngineTimeline(const EngineTimeline&) = delete;
+		EngineTimeline& operator=(const EngineTimeline&) = delete;
+
+		// Submits with the timeline appended to the signal semaphores and returns the value it signals.
+		// submitInfo may signal binary semaphores but must not chain a pNext of its own
+		uint64_t Submit(VkQueue queue, const VkSubmitInfo& submitInfo);
+		// vkQueuePresentKHR under the submission lock, present through this when the queue is shared
+		VkResult Present(VkQueue queue, const VkPresentInfoKHR& presentInfo);
+
+		// Non-blocking, the highest value the GPU has reached
+		uint64_t GetCompletedValue();
+		bool IsComplete(uint64_t value) { return value <= completedValue.load() || value <= GetCompletedValue(); }
+		uint64_t GetLastSubmittedValue() const { return lastSubmittedValue.load(); }
+		// Blocks until value completed, 0 returns at once
+		void Wait(uint64_t value);
+		void WaitIdle() { Wait(lastSubmittedValue.load()); }
+
+		// Runs callback from Poll once value completed, e.g. to free what the submission used
+		void OnComplete(uint64_t value, std::function<void()> callback);
+		// Runs the callbacks of every completed value, call once per frame
+		void Poll();
+		// Waits for all submitted work and runs every callback
+		void Drain();
+
+		VkSemaphore GetSemaphore() const { return semaphore; }
+
+	private:
+		static constexpr uint32_t MAX_SIGNAL_SEMAPHORES = 8;
+
+		// Only ever raises completedValue, racing updates keep the highest
+		void raiseCompletedValue(uint64_t value);
+
+		VkDevice device;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		// Guards the queues so values reach them in increasing order and presents don't overlap submits
+		std::mutex queueMutex;
+		std::atomic<uint64_t> lastSubmittedValue{ 0 };
+		std::atomic<uint64_t> completedValue{ 0 };
+		std::mutex callbackMutex;
+		std::multimap<uint64_t, std::function<void()>> completionCallbacks;
+	};
+}
@@ -0,0 +1,50 @@
+#include "engine_uniform_allocator.hpp"
+#include "engine_swap_chain.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Engine {
+
+	EngineUniformAllocator::EngineUniformAllocator(EngineDevice& device, VkDeviceSize bytesPerFrame) {
+		// Both limits are powers of two, the larger one satisfies both. The atom size keeps
+		// each frame's flush range valid on non coherent memory
+		const auto& limits = device.properties.limits;
+		alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+
+		buffer = std::make_unique<EngineBuffer>(
+			device,
+			bytesPerFrame,
+			EngineSwapChain::MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			alignment
+		);
+		buffer->map();
+		frameSize = buffer->getAlignmentSize();
+	}
+
+	void EngineUniformAllocator::BeginFrame(int frameIndex) {
+		this->frameIndex = frameIndex;
+		cursor = frameIndex * frameSize;
+	}
+
+	uint32_t EngineUniformAllocator::Allocate(const void* data, VkDeviceSize size) {
+		VkDeviceSize offset = (cursor + alignment - 1) & ~(alignment - 1);
+		if (offset + size > (frameIndex + 1) * frameSize) {
+			throw std::runtime_error("Uniform allocator frame region exhausted");
+		}
+		std::memcpy(static_cast<char*>(buffer->getMappedMemory()) + offset, data, size);
+		cursor = offset + size;
+		return static_cast<uint32_t>(offset);
+	}
+
+	void EngineUniformAllocator::Flush() {
+		buffer->flushIndex(frameIndex);
+	}
+
+	VkDescriptorBufferInfo EngineUniformAllocator::DescriptorInfo(VkDeviceSize range) const {
+		return VkDescriptorBufferInfo{ buffer->getBuffer(), 0, range };
+	}
+}
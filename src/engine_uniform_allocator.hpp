@@ -0,0 +1,41 @@
+#pragma once
+
+#include "engine_device.hpp"
+#include "engine_buffer.hpp"
+
+#include <memory>
+
+namespace Engine {
+
+	// One persistently mapped uniform buffer split into a region per frame in flight.
+	// Uniform blocks of the frame (global data, per view or per pass data) are sub-allocated
+	// linearly from the frame's region at minUniformBufferOffsetAlignment, and read through a
+	// single UNIFORM_BUFFER_DYNAMIC descriptor with the returned offset as its dynamic offset
+	class EngineUniformAllocator {
+	public:
+		EngineUniformAllocator(EngineDevice& device, VkDeviceSize bytesPerFrame);
+
+		EngineUniformAllocator(const EngineUniformAllocator&) = delete;
+		EngineUniformAllocator& operator=(const EngineUniformAllocator&) = delete;
+
+		// Starts allocating from the frame slot's region, the frame last recorded in it must have finished
+		void BeginFrame(int frameIndex);
+		// Copies size bytes into the frame's region and returns their dynamic offset
+		uint32_t Allocate(const void* data, VkDeviceSize size);
+		template <typename T>
+		uint32_t Allocate(const T& data) { return Allocate(&data, sizeof(T)); }
+		// Makes the frame's writes visible to the device, call before submitting
+		void Flush();
+
+		// Descriptor for blocks of range bytes, the dynamic offset picks the block
+		VkDescriptorBufferInfo DescriptorInfo(VkDeviceSize range) const;
+		VkDeviceSize GetAlignment() const { return alignment; }
+
+	private:
+		std::unique_ptr<EngineBuffer> buffer;
+		VkDeviceSize alignment;
+		VkDeviceSize frameSize;
+		int frameIndex = 0;
+		VkDeviceSize cursor = 0;
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdio>
 #include <functional>
+#include <string>
 
 namespace Engine {
 
@@ -11,4 +13,28 @@ namespace Engine {
 		(HashCombine(seed, rest), ...);
 	};
 
+	// value as a quoted JSON string, quotes, backslashes and control characters escaped
+	inline std::string JsonString(const std::string& value) {
+		std::string escaped = "\"";
+		for (char c : value) {
+			switch (c) {
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char code[8];
+					std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+					escaped += code;
+				}
+				else {
+					escaped += c;
+				}
+			}
+		}
+		return escaped + "\"";
+	}
+
 }  // namespace Engine
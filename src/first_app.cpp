@@ -1,123 +1,370 @@
 #include "first_app.hpp"
 #include "systems/simple_render_system.hpp"
 #include "systems/point_light_system.hpp"
+#include "systems/deferred_render_system.hpp"
 #include "engine_camera.hpp"
 #include "engine_buffer.hpp"
+#include "engine_light_clusters.hpp"
+#include "engine_object_buffer.hpp"
+#include "engine_uniform_allocator.hpp"
 #include "keyboard_movement_controller.hpp"
+#include "engine_profiler.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <stdexcept>
 #include <array>
 #include <chrono>
+#include <iostream>
 
 
 namespace Engine {
 
-	FirstApp::FirstApp() {
-		globalPool = EngineDescriptorPool::Builder(engineDevice)
-			.setMaxSets(EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.build();
-		loadGameObjects();
+	// Room for the GlobalUbo and any per view or per pass uniform blocks of a frame
+	static constexpr VkDeviceSize UNIFORM_BYTES_PER_FRAME = 64 * 1024;
+
+	static double millisecondsSince(std::chrono::steady_clock::time_point& start) {
+		auto now = std::chrono::steady_clock::now();
+		double milliseconds = std::chrono::duration<double, std::milli>(now - start).count();
+		start = now;
+		return milliseconds;
 	}
 
-	FirstApp::~FirstApp() {
+	static EngineSwapChain::Settings rendererSettings(const FirstApp::Settings& settings) {
+		EngineSwapChain::Settings swapChain = settings.swapChain;
+		swapChain.deferred = settings.deferredShading;
+		return swapChain;
 	}
 
-	void FirstApp::run() {
-		std::vector<std::unique_ptr<EngineBuffer> > uboBuffers{ EngineSwapChain::MAX_FRAMES_IN_FLIGHT };
-		for (int i = 0; i < uboBuffers.size(); i++) {
-			uboBuffers[i] = std::make_unique<EngineBuffer>(
-				engineDevice,
-				sizeof(GlobalUbo),
-				1,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-			);
-			uboBuffers[i]->map();
+	FirstApp::FirstApp() : FirstApp(Settings{}) {}
+
+	FirstApp::FirstApp(const Settings& settings)
+		: settings{ settings },
+		engineWindow{ settings.headless ? nullptr
+			: std::make_unique<EngineWindow>(settings.extent.width, settings.extent.height, "Hello Vulkan!") },
+		engineDevicePtr{ engineWindow != nullptr ? std::make_unique<EngineDevice>(*engineWindow)
+			: std::make_unique<EngineDevice>() },
+		engineRendererPtr{ engineWindow != nullptr
+			? std::make_unique<EngineRenderer>(*engineWindow, *engineDevicePtr, rendererSettings(settings))
+			: std::make_unique<EngineRenderer>(*engineDevicePtr, settings.extent, rendererSettings(settings)) } {
+		assert((!settings.headless || settings.frameCount > 0) && "Nothing ends a headless run without a frame count");
+		// Every frame's uniform blocks live in one buffer, selected by dynamic offset
+		layoutCache.SetDescriptorTypeOverride(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		// Textures and per-material buffers are indexed out of one set instead of bound per material
+		if (engineDevice.supportsBindless()) {
+			bindlessTable = std::make_unique<EngineBindlessTable>(engineDevice, EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+			layoutCache.SetExternalSetLayout(BINDLESS_SET, bindlessTable->GetSetLayout());
+		}
+		engineRenderer.SetFrameReleaseCallback([this](int frameIndex) {
+			frameDescriptorAllocator.ReleaseFrame(frameIndex);
+			gpuTimer.ReleaseFrame(frameIndex);
+			if (bindlessTable != nullptr)
+				bindlessTable->ReleaseFrame(frameIndex);
+		});
+
+		if (enableShaderHotReload) {
+			shaderWatcher = std::make_unique<EngineShaderWatcher>("shaders");
 		}
+	}
 
-		auto globalSetLayout = EngineDescriptorSetLayout::Builder(engineDevice)	
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-			.build();
+	FirstApp::~FirstApp() {
+	}
 
-		std::vector<VkDescriptorSet> globalDescriptorSets(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
-		for (int i = 0; i < globalDescriptorSets.size(); i++) {
-			auto bufferInfo = uboBuffers[i]->descriptorInfo();
-			EngineDescriptorWriter(*globalSetLayout, *globalPool)
-				.writeBuffer(0, &bufferInfo)
-				.build(globalDescriptorSets[i]);
+	void FirstApp::run() {
+		ENGINE_PROFILE_THREAD_NAME("Main");
+		{
+			ENGINE_PROFILE_ZONE("Load game objects");
+			loadGameObjects();
 		}
 
-		SimpleRenderSystem simpleRenderSystem{ 
-			engineDevice, 
-			engineRenderer.GetSwapChainRenderPass(), 
-			globalSetLayout->getDescriptorSetLayout()};
+		EngineUniformAllocator uniformAllocator{ engineDevice, UNIFORM_BYTES_PER_FRAME };
+
+		// Set 0 is declared the same by every shader, the layout cache hands out one shared layout for it.
+		// Set 1 holds the clustered lights read by the simple shader, set 2 the object transforms
+		auto& simpleLayout = layoutCache.GetLayout(
+			"shaders/simple_shader.vert.spv",
+			"shaders/simple_shader.frag.spv"
+		);
+		auto& globalSetLayout = *simpleLayout.setLayouts.at(0);
+		EngineLightClusters lightClusters{ engineDevice, *simpleLayout.setLayouts.at(1), descriptorAllocator };
+		EngineObjectBuffer objectBuffer{ engineDevice, *simpleLayout.setLayouts.at(2), descriptorAllocator };
+
+		VkDescriptorSet globalDescriptorSet;
+		auto bufferInfo = uniformAllocator.DescriptorInfo(sizeof(GlobalUbo));
+		EngineDescriptorWriter(globalSetLayout, descriptorAllocator)
+			.writeBuffer(0, &bufferInfo)
+			.build(globalDescriptorSet);
+
+		// Both paths request their pipelines from the library, new permutations compile concurrently.
+		// Point light billboards are drawn in the lighting subpass on the deferred path
+		std::unique_ptr<SimpleRenderSystem> simpleRenderSystem{};
+		std::unique_ptr<DeferredRenderSystem> deferredRenderSystem{};
+		if (settings.deferredShading) {
+			deferredRenderSystem = std::make_unique<DeferredRenderSystem>(
+				engineDevice,
+				pipelineLibrary,
+				layoutCache,
+				engineRenderer.GetDeferredRenderPass());
+		}
+		else {
+			simpleRenderSystem = std::make_unique<SimpleRenderSystem>(
+				engineDevice,
+				pipelineLibrary,
+				layoutCache,
+				engineRenderer.GetSwapChainRenderPass());
+		}
 		
 		PointLightSystem pointLightSystem{
 			engineDevice,
-			engineRenderer.GetSwapChainRenderPass(),
-			globalSetLayout->getDescriptorSetLayout() };
+			pipelineLibrary,
+			layoutCache,
+			settings.deferredShading ? engineRenderer.GetDeferredRenderPass() : engineRenderer.GetSwapChainRenderPass(),
+			settings.deferredShading ? 1u : 0u };
 		EngineCamera camera{};
 		camera.SetViewTarget(glm::vec3{ -1.f, -2.f, -20.f }, glm::vec3{ 0.0f, 0.0f, 2.5f });
 
 		auto viewerObject = EngineGameObject::CreateGameObject();
-		KeyboardMovementController cameraController{};
+
+		// A fixed frame count measures steady state, not pipelines still compiling in the background
+		if (settings.frameCount > 0) {
+			pipelineCompiler.WaitIdle();
+		}
 
 		auto currentTime = std::chrono::high_resolution_clock::now();
+		uint64_t frameNumber = 0;
 
-		while (!engineWindow.ShouldClose()) {
-			glfwPollEvents();
+		while (engineWindow == nullptr || !engineWindow->ShouldClose()) {
+			if (settings.frameCount > 0 && frameNumber >= settings.frameCount)
+				break;
+			ENGINE_PROFILE_ZONE("Frame");
+
+			auto frameStart = std::chrono::steady_clock::now();
+			auto phaseStart = frameStart;
+			FrameTimings timings{};
+
+			if (engineWindow != nullptr) {
+				ENGINE_PROFILE_ZONE("Poll events");
+				glfwPollEvents();
+				updateSwapChainSettings();
+			}
+			reloadChangedShaders();
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
-			cameraController.MoveInPlaneXZ(engineWindow.GetGLFWWindow(), frameTime, viewerObject);
-			camera.SetViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
-
-			float aspect = engineRenderer.GetAspectRatio();
-			camera.SetPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+			if (settings.fixedTimeStep > 0.0f)
+				frameTime = settings.fixedTimeStep;
+			{
+				ENGINE_PROFILE_ZONE("Camera");
+				updateCamera(frameTime, viewerObject);
+				camera.SetViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+
+				float aspect = engineRenderer.GetAspectRatio();
+				camera.SetPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+			}
 
+			millisecondsSince(phaseStart);
 			if (auto commandBuffer = engineRenderer.BeginFrame()) {
+				timings.beginFrameMs = millisecondsSince(phaseStart);
 			
 				int frameIndex = engineRenderer.GetFrameIndex();
+				if (gpuTimer.BeginFrame(frameIndex, commandBuffer, frameNumber + 1)) {
+					timings.gpuZones = gpuTimer.GetResults();
+					timings.gpuFrameNumber = gpuTimer.GetResultsFrameNumber();
+				}
+				uint32_t frameZone = gpuTimer.BeginZone(commandBuffer, "Frame");
+
+				// Update
+				uint32_t globalUboOffset;
+				{
+					ENGINE_PROFILE_ZONE("UBO update");
+					GlobalUbo ubo{};
+					ubo.projection = camera.GetProjection();
+					ubo.view = camera.GetView();
+					ubo.inverseViewMatrix = camera.GetInverseView();
+					VkExtent2D extent = engineRenderer.GetSwapChainExtent();
+					ubo.screenSize = glm::vec2(extent.width, extent.height);
+					ubo.zNear = camera.GetNear();
+					ubo.zFar = camera.GetFar();
+					uniformAllocator.BeginFrame(frameIndex);
+					frameDescriptorAllocator.BeginFrame(frameIndex);
+					if (bindlessTable != nullptr)
+						bindlessTable->BeginFrame(frameIndex);
+					globalUboOffset = uniformAllocator.Allocate(ubo);
+				}
+
 				FrameInfo frameInfo{
 					frameIndex,
 					frameTime,
 					commandBuffer,
+					engineRenderer.GetCommandRecorder(),
 					camera,
-					globalDescriptorSets[frameIndex],
-					gameObjects
+					globalDescriptorSet,
+					globalUboOffset,
+					lightClusters.GetDescriptorSet(frameIndex),
+					objectBuffer.GetDescriptorSet(frameIndex),
+					objectBuffer,
+					settings.deferredShading ? engineRenderer.GetGBufferDescriptorSet() : VK_NULL_HANDLE,
+					bindlessTable != nullptr ? bindlessTable->GetDescriptorSet() : VK_NULL_HANDLE,
+					gameObjects,
+					drawQueue,
+					frameDescriptorAllocator
 				};
-				// Update
-				GlobalUbo ubo{};
-				ubo.projection = camera.GetProjection();
-				ubo.view = camera.GetView();
-				ubo.inverseViewMatrix = camera.GetInverseView();
-				pointLightSystem.update(frameInfo, ubo);
-				uboBuffers[frameIndex]->writeToBuffer(&ubo);
-				uboBuffers[frameIndex]->flush();
+				timings.frameSetupMs = millisecondsSince(phaseStart);
+				{
+					ENGINE_PROFILE_ZONE("Light update");
+					pointLightSystem.update(frameInfo, lightClusters);
+				}
+				timings.lightUpdateMs = millisecondsSince(phaseStart);
+				{
+					ENGINE_PROFILE_ZONE("Object update");
+					objectBuffer.Update(frameIndex, gameObjects);
+					uniformAllocator.Flush();
+				}
+				timings.objectUpdateMs = millisecondsSince(phaseStart);
 
 					
 				// Render
 
-				engineRenderer.BeginSwapChainRenderPass(commandBuffer);
-
-				// Render solid first, transperant next
-				simpleRenderSystem.RenderGameObjects(frameInfo);
-				pointLightSystem.render(frameInfo);
+				if (settings.deferredShading) {
+					engineRenderer.BeginDeferredRenderPass(commandBuffer);
+					uint32_t geometryZone = gpuTimer.BeginZone(commandBuffer, "Geometry");
+					{
+						ENGINE_PROFILE_ZONE("DeferredRenderSystem geometry");
+						deferredRenderSystem->RenderGeometry(frameInfo);
+					}
+					timings.geometryMs = millisecondsSince(phaseStart);
+					{
+						ENGINE_PROFILE_ZONE("Draw queue flush");
+						drawQueue.Flush(frameInfo.recorder);
+					}
+					gpuTimer.EndZone(commandBuffer, geometryZone);
+					timings.drawQueueFlushMs = millisecondsSince(phaseStart);
+					engineRenderer.NextSubpass(commandBuffer);
+					uint32_t lightingZone = gpuTimer.BeginZone(commandBuffer, "Lighting");
+					{
+						ENGINE_PROFILE_ZONE("DeferredRenderSystem lighting");
+						deferredRenderSystem->RenderLighting(frameInfo, lightClusters.GetLightCount());
+					}
+					timings.deferredLightingMs = millisecondsSince(phaseStart);
+					{
+						ENGINE_PROFILE_ZONE("PointLightSystem render");
+						pointLightSystem.render(frameInfo);
+					}
+					gpuTimer.EndZone(commandBuffer, lightingZone);
+					timings.pointLightRenderMs = millisecondsSince(phaseStart);
+				}
+				else {
+					engineRenderer.BeginSwapChainRenderPass(commandBuffer);
+
+					// Render solid first, transperant next
+					uint32_t geometryZone = gpuTimer.BeginZone(commandBuffer, "Geometry");
+					{
+						ENGINE_PROFILE_ZONE("SimpleRenderSystem render");
+						simpleRenderSystem->RenderGameObjects(frameInfo);
+					}
+					timings.geometryMs = millisecondsSince(phaseStart);
+					{
+						ENGINE_PROFILE_ZONE("Draw queue flush");
+						drawQueue.Flush(frameInfo.recorder);
+					}
+					gpuTimer.EndZone(commandBuffer, geometryZone);
+					timings.drawQueueFlushMs = millisecondsSince(phaseStart);
+					uint32_t lightingZone = gpuTimer.BeginZone(commandBuffer, "Point lights");
+					{
+						ENGINE_PROFILE_ZONE("PointLightSystem render");
+						pointLightSystem.render(frameInfo);
+					}
+					gpuTimer.EndZone(commandBuffer, lightingZone);
+					timings.pointLightRenderMs = millisecondsSince(phaseStart);
+				}
 
 				engineRenderer.EndSwapChainRenderPass(commandBuffer);
+				gpuTimer.EndZone(commandBuffer, frameZone);
+				ENGINE_PROFILE_COUNTER("Draws", frameInfo.recorder.GetStats().draws);
+				ENGINE_PROFILE_COUNTER("Lights", lightClusters.GetLightCount());
 				engineRenderer.EndFrame();
+				timings.endFrameMs = millisecondsSince(phaseStart);
 
+				timings.frameNumber = ++frameNumber;
+				timings.frameMs = std::chrono::duration<double, std::milli>(phaseStart - frameStart).count();
+				onFrameComplete(timings);
 			}
 		}
 
 		vkDeviceWaitIdle(engineDevice.device());
+
+		if (!settings.traceFile.empty()) {
+			if (!EngineProfiler::IsEnabled())
+				std::cout << "Built without ENGINE_PROFILER, no trace written" << std::endl;
+			else if (EngineProfiler::WriteChromeTrace(settings.traceFile))
+				std::cout << "Wrote profiler trace to " << settings.traceFile << std::endl;
+			else
+				std::cout << "Failed to write profiler trace to " << settings.traceFile << std::endl;
+		}
+	}
+
+	void FirstApp::updateCamera(float frameTime, EngineGameObject& viewerObject) {
+		if (engineWindow != nullptr) {
+			cameraController.MoveInPlaneXZ(engineWindow->GetGLFWWindow(), frameTime, viewerObject);
+		}
+	}
+
+	void FirstApp::updateSwapChainSettings() {
+		static constexpr std::array<VkPresentModeKHR, 4> presentModes{
+			VK_PRESENT_MODE_FIFO_KHR,
+			VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+			VK_PRESENT_MODE_MAILBOX_KHR,
+			VK_PRESENT_MODE_IMMEDIATE_KHR
+		};
+
+		// Acts on the press only, not every frame the key is held
+		GLFWwindow* window = engineWindow->GetGLFWWindow();
+		bool presentModeKeyDown = glfwGetKey(window, presentModeKey) == GLFW_PRESS;
+		bool framesInFlightKeyDown = glfwGetKey(window, framesInFlightKey) == GLFW_PRESS;
+		bool changed = false;
+
+		if (presentModeKeyDown && !presentModeKeyWasDown) {
+			// Cycle from the mode in use and skip the ones the surface doesn't report, FIFO always is
+			auto current = std::find(presentModes.begin(), presentModes.end(), engineRenderer.GetPresentMode());
+			size_t next = current == presentModes.end() ? 0 : current - presentModes.begin();
+			do {
+				next = (next + 1) % presentModes.size();
+			} while (!engineRenderer.IsPresentModeSupported(presentModes[next]));
+			engineRenderer.SetPresentMode(presentModes[next]);
+			std::cout << "Present mode: " << EngineSwapChain::presentModeName(presentModes[next]) << std::endl;
+			changed = true;
+		}
+		if (framesInFlightKeyDown && !framesInFlightKeyWasDown) {
+			engineRenderer.SetFramesInFlight(engineRenderer.GetFramesInFlight() % EngineSwapChain::MAX_FRAMES_IN_FLIGHT + 1);
+			changed = true;
+		}
+		presentModeKeyWasDown = presentModeKeyDown;
+		framesInFlightKeyWasDown = framesInFlightKeyDown;
+
+		if (changed) {
+			auto& latency = engineRenderer.GetLatencyStats();
+			std::cout << "Frames in flight: " << engineRenderer.GetFramesInFlight()
+				<< (latency.present ? ", present latency" : ", frame completion observed")
+				<< " before change: " << latency.averageMs << " ms avg, " << latency.maxMs << " ms max" << std::endl;
+			engineRenderer.ResetLatencyStats();
+		}
+	}
+
+	void FirstApp::reloadChangedShaders() {
+		ENGINE_PROFILE_ZONE("Shader reload");
+		if (shaderWatcher != nullptr) {
+			for (auto& shaderFilePath : shaderWatcher->PollChanges()) {
+				pipelineCompiler.ReloadShader(shaderFilePath);
+			}
+		}
+		// Frame boundary: rebuilt pipelines are swapped in before any command is recorded
+		pipelineCompiler.CommitReloads();
 	}
 
 	void FirstApp::loadGameObjects() {
@@ -6,8 +6,19 @@
 #include "engine_model.hpp"
 #include "engine_renderer.hpp"														
 #include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_bindless_table.hpp"
+#include "engine_pipeline_compiler.hpp"
+#include "engine_pipeline_library.hpp"
+#include "engine_pipeline_layout_cache.hpp"
+#include "engine_render_queue.hpp"
+#include "engine_shader_library.hpp"
+#include "engine_shader_watcher.hpp"
+#include "engine_gpu_timer.hpp"
+#include "keyboard_movement_controller.hpp"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 
@@ -19,23 +30,103 @@ namespace Engine {
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 800;
+		#ifdef NDEBUG
+			static constexpr bool enableShaderHotReload = false;
+		#else
+			static constexpr bool enableShaderHotReload = true;
+		#endif
+		// Cycle the present mode and the number of frames in flight, trading latency for throughput
+		static constexpr int presentModeKey = GLFW_KEY_P;
+		static constexpr int framesInFlightKey = GLFW_KEY_F;
+
+		struct Settings {
+			// Renders offscreen on a headless device, no window or display needed
+			bool headless = false;
+			VkExtent2D extent{ WIDTH, HEIGHT };
+			// Frames to render before run returns, 0 runs until the window is closed
+			uint32_t frameCount = 0;
+			// Seconds the scene advances per frame, 0 uses the measured frame time
+			float fixedTimeStep = 0.0f;
+			// Shade from a subpass-local G-buffer instead of the clustered forward pass,
+			// swapChain.deferred follows it
+			bool deferredShading = false;
+			EngineSwapChain::Settings swapChain{};
+			// Chrome trace of the profiler zones written when run returns, needs ENGINE_PROFILER
+			std::string traceFile;
+		};
+
+		// CPU time of one frame's phases in milliseconds, and GPU time of an earlier frame
+		struct FrameTimings {
+			uint64_t frameNumber = 0;
+			double frameMs = 0.0;
+			// BeginFrame, waiting for the frame slot and acquiring an image
+			double beginFrameMs = 0.0;
+			// GPU timer readback, per frame allocators, global uniforms and the FrameInfo
+			double frameSetupMs = 0.0;
+			// PointLightSystem update and light clustering
+			double lightUpdateMs = 0.0;
+			// Object transforms and flushing the frame's uniforms
+			double objectUpdateMs = 0.0;
+			// Recording per render system, beginning a render pass or subpass counts to the system after it.
+			// SimpleRenderSystem, or DeferredRenderSystem geometry when deferred
+			double geometryMs = 0.0;
+			double drawQueueFlushMs = 0.0;
+			// DeferredRenderSystem lighting, 0 when forward
+			double deferredLightingMs = 0.0;
+			double pointLightRenderMs = 0.0;
+			// Ending the render pass, EndFrame, submit and present
+			double endFrameMs = 0.0;
+			// Empty until a frame's timestamps were read back. They trail the frame by the frames in
+			// flight, gpuFrameNumber is the frameNumber they were recorded in
+			std::vector<EngineGpuTimer::Zone> gpuZones;
+			uint64_t gpuFrameNumber = 0;
+		};
 
 		FirstApp();
-		~FirstApp();
+		explicit FirstApp(const Settings& settings);
+		virtual ~FirstApp();
 		FirstApp(const FirstApp&) = delete;
 		FirstApp& operator=(const FirstApp&) = delete;
 
 		void run();
 
 
-	private:
-		void loadGameObjects();
+	protected:
+		// Fills gameObjects, called once at the start of run
+		virtual void loadGameObjects();
+		// Moves the viewer every frame, with the keyboard unless overridden
+		virtual void updateCamera(float frameTime, EngineGameObject& viewerObject);
+		// Called after every submitted frame
+		virtual void onFrameComplete(const FrameTimings& timings) {}
 
-		EngineWindow engineWindow{ WIDTH, HEIGHT, "Hello Vulkan!" };
-		EngineDevice engineDevice{ engineWindow };
-		EngineRenderer engineRenderer{ engineWindow, engineDevice };
+		Settings settings;
+		// Null when headless
+		std::unique_ptr<EngineWindow> engineWindow;
+		std::unique_ptr<EngineDevice> engineDevicePtr;
+		EngineDevice& engineDevice{ *engineDevicePtr };
+		std::unique_ptr<EngineRenderer> engineRendererPtr;
+		EngineRenderer& engineRenderer{ *engineRendererPtr };
+		EngineShaderLibrary shaderLibrary{ engineDevice };
+		EnginePipelineLayoutCache layoutCache{ engineDevice, shaderLibrary };
+		EnginePipelineCompiler pipelineCompiler{ engineDevice, shaderLibrary };
+		EnginePipelineLibrary pipelineLibrary{ pipelineCompiler };
+		std::unique_ptr<EngineShaderWatcher> shaderWatcher{};
 
-		std::unique_ptr<EngineDescriptorPool> globalPool{};
+		// Sets that live as long as the app, and sets recycled when their frame slot comes around again
+		EngineDescriptorAllocator descriptorAllocator{ engineDevice };
+		EngineDescriptorAllocator frameDescriptorAllocator{ engineDevice, EngineSwapChain::MAX_FRAMES_IN_FLIGHT };
+		// Null without descriptor indexing support
+		std::unique_ptr<EngineBindlessTable> bindlessTable{};
 		EngineGameObject::Map gameObjects;
+		EngineDrawQueue drawQueue{};
+		EngineGpuTimer gpuTimer{ engineDevice };
+
+	private:
+		void reloadChangedShaders();
+		void updateSwapChainSettings();
+
+		KeyboardMovementController cameraController{};
+		bool presentModeKeyWasDown = false;
+		bool framesInFlightKeyWasDown = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "deferred_render_system.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cassert>
+
+
+namespace Engine {
+
+	static constexpr uint32_t GEOMETRY_SUBPASS = 0;
+	static constexpr uint32_t LIGHTING_SUBPASS = 1;
+
+	DeferredRenderSystem::DeferredRenderSystem(
+		EngineDevice& device,
+		EnginePipelineLibrary& pipelineLibrary,
+		EnginePipelineLayoutCache& layoutCache,
+		VkRenderPass deferredRenderPass)
+		: engineDevice(device),
+		geometryLayout(layoutCache.GetLayout("shaders/simple_shader.vert.spv", "shaders/deferred_gbuffer.frag.spv")),
+		compositeLayout(layoutCache.GetLayout("shaders/deferred_composite.vert.spv", "shaders/deferred_composite.frag.spv")),
+		lightLayout(layoutCache.GetLayout("shaders/deferred_light.vert.spv", "shaders/deferred_light.frag.spv")) {
+		assert(geometryLayout.setLayouts.size() == 3 && "Geometry shaders expect the global and object sets");
+		assert(compositeLayout.setLayouts.size() == 3 && lightLayout.setLayouts.size() == 3 &&
+			"Lighting shaders expect the global, light and G-buffer sets");
+		createPipelines(pipelineLibrary, deferredRenderPass);
+	}
+
+	void DeferredRenderSystem::createPipelines(EnginePipelineLibrary& pipelineLibrary, VkRenderPass renderPass) {
+		auto geometryConfig = std::make_unique<PipelineConfigInfo>();
+		EnginePipeline::DefaultPipelineConfigInfo(*geometryConfig);
+		EnginePipeline::SetColorAttachmentCount(*geometryConfig, 2);
+		geometryConfig->renderPass = renderPass;
+		geometryConfig->subpass = GEOMETRY_SUBPASS;
+		geometryConfig->pipelineLayout = geometryLayout.pipelineLayout;
+		geometryPipeline = pipelineLibrary.GetOrCreate(
+			"shaders/simple_shader.vert.spv",
+			"shaders/deferred_gbuffer.frag.spv",
+			std::move(geometryConfig)
+		);
+
+		// Both lighting pipelines generate their vertices and only read depth through the G-buffer
+		auto makeLightingConfig = [&](const PipelineLayoutInfo& layout) {
+			auto config = std::make_unique<PipelineConfigInfo>();
+			EnginePipeline::DefaultPipelineConfigInfo(*config);
+			config->attributeDescriptions.clear();
+			config->bindingDescriptions.clear();
+			config->depthStencilInfo.depthTestEnable = VK_FALSE;
+			config->depthStencilInfo.depthWriteEnable = VK_FALSE;
+			config->renderPass = renderPass;
+			config->subpass = LIGHTING_SUBPASS;
+			config->pipelineLayout = layout.pipelineLayout;
+			return config;
+		};
+
+		compositePipeline = pipelineLibrary.GetOrCreate(
+			"shaders/deferred_composite.vert.spv",
+			"shaders/deferred_composite.frag.spv",
+			makeLightingConfig(compositeLayout)
+		);
+
+		auto lightConfig = makeLightingConfig(lightLayout);
+		EnginePipeline::EnableAdditiveBlending(*lightConfig);
+		lightPipeline = pipelineLibrary.GetOrCreate(
+			"shaders/deferred_light.vert.spv",
+			"shaders/deferred_light.frag.spv",
+			std::move(lightConfig)
+		);
+	}
+
+	void DeferredRenderSystem::RenderGeometry(FrameInfo& frameInfo) {
+		EnginePipeline* pipeline = geometryPipeline.Get();
+		if (pipeline == nullptr)
+			return;
+
+		// Set 1 is an empty gap, the G-buffer pass doesn't read lights
+		EngineDrawQueue::Packet packet{};
+		packet.pipeline = pipeline;
+		packet.pipelineLayout = geometryLayout.pipelineLayout;
+		packet.descriptorSets[0] = frameInfo.globalDescriptorSet;
+		packet.dynamicSetMask = 1u << 0;
+		packet.dynamicOffsets[0] = frameInfo.globalUboOffset;
+		packet.descriptorSets[2] = frameInfo.objectDescriptorSet;
+		packet.descriptorSetCount = 3;
+
+		const glm::mat4& view = frameInfo.camera.GetView();
+		for (auto& keyVal : frameInfo.gameObjects) {
+			auto& obj = keyVal.second;
+			if (obj.model == nullptr) continue;
+
+			packet.model = obj.model.get();
+			packet.firstInstance = frameInfo.objectBuffer.GetObjectIndex(obj.GetId());
+			float viewDepth = (view * glm::vec4(obj.transform.translation, 1.0f)).z;
+			frameInfo.drawQueue.Push(DRAW_PASS_OPAQUE, viewDepth, packet, nullptr);
+		}
+	}
+
+	void DeferredRenderSystem::RenderLighting(FrameInfo& frameInfo, uint32_t lightCount) {
+		assert(frameInfo.gBufferDescriptorSet != VK_NULL_HANDLE && "Deferred lighting needs the G-buffer set");
+
+		// Ambient over every covered pixel
+		if (compositePipeline.Bind(frameInfo.recorder)) {
+			frameInfo.recorder.BindDescriptorSets(
+				compositeLayout.pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+			frameInfo.recorder.BindDescriptorSets(compositeLayout.pipelineLayout, 2, 1, &frameInfo.gBufferDescriptorSet);
+			frameInfo.recorder.Draw(3, 1, 0, 0);
+		}
+
+		// One instanced quad per light, covering the screen bounds of its range
+		if (lightCount > 0 && lightPipeline.Bind(frameInfo.recorder)) {
+			VkDescriptorSet descriptorSets[] = { frameInfo.lightDescriptorSet, frameInfo.gBufferDescriptorSet };
+			frameInfo.recorder.BindDescriptorSets(
+				lightLayout.pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+			frameInfo.recorder.BindDescriptorSets(lightLayout.pipelineLayout, 1, 2, descriptorSets);
+			frameInfo.recorder.Draw(6, lightCount, 0, 0);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "engine_game_object.hpp"
+#include "engine_device.hpp"
+#include "engine_pipeline.hpp"
+#include "engine_pipeline_library.hpp"
+#include "engine_pipeline_layout_cache.hpp"
+#include "engine_frame_info.hpp"
+#include "engine_model.hpp"
+#include "engine_camera.hpp"
+
+#include <memory>
+#include <vector>
+
+
+namespace Engine {
+
+	// Alternative to SimpleRenderSystem for EngineRenderer's deferred render pass.
+	// Geometry writes albedo, normal and depth into the G-buffer in subpass 0, subpass 1 reads them
+	// as input attachments, adds ambient light and accumulates each point light over its screen rect
+	class DeferredRenderSystem {
+	public:
+		DeferredRenderSystem(
+			EngineDevice& device,
+			EnginePipelineLibrary& pipelineLibrary,
+			EnginePipelineLayoutCache& layoutCache,
+			VkRenderPass deferredRenderPass);
+		DeferredRenderSystem(const DeferredRenderSystem&) = delete;
+		DeferredRenderSystem& operator=(const DeferredRenderSystem&) = delete;
+
+		// Queues the G-buffer draws into frameInfo.drawQueue, flush it before the lighting subpass
+		void RenderGeometry(FrameInfo& frameInfo);
+		// lightCount lights are read from the light buffer in frameInfo.lightDescriptorSet
+		void RenderLighting(FrameInfo& frameInfo, uint32_t lightCount);
+
+	private:
+		void createPipelines(EnginePipelineLibrary& pipelineLibrary, VkRenderPass renderPass);
+
+		EngineDevice& engineDevice;
+		EnginePipelineHandle geometryPipeline;
+		EnginePipelineHandle compositePipeline;
+		EnginePipelineHandle lightPipeline;
+		// Owned by the layout cache
+		const PipelineLayoutInfo& geometryLayout;
+		const PipelineLayoutInfo& compositeLayout;
+		const PipelineLayoutInfo& lightLayout;
+	};
+}
@@ -1,4 +1,5 @@
 #include "point_light_system.hpp"
+#include "engine_swap_chain.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,122 +8,119 @@
 
 #include <stdexcept>
 #include <array>
-#include <map>
 
 namespace Engine {
 
-	struct PointLightPushConstants{
-		glm::vec4 position{};
-		glm::vec4 color {};
-		float radius;
-	};
+	static constexpr uint32_t INITIAL_BILLBOARD_CAPACITY = 64;
+	static constexpr uint32_t BILLBOARD_SET = 1;
 
-	PointLightSystem::PointLightSystem(EngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetlayout)
+	PointLightSystem::PointLightSystem(
+		EngineDevice& device,
+		EnginePipelineLibrary& pipelineLibrary,
+		EnginePipelineLayoutCache& layoutCache,
+		VkRenderPass renderPass,
+		uint32_t subpass)
 		: engineDevice(device) {
-		createPipelineLayout(globalSetlayout);
-		createPipeline(renderPass);
-	}
+		createPipelineLayout(layoutCache);
+		createPipeline(pipelineLibrary, renderPass, subpass);
 
-	PointLightSystem::~PointLightSystem() {
-		vkDestroyPipelineLayout(engineDevice.device(), pipelineLayout, nullptr);
+		frames.resize(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames) {
+			EngineBuffer::reserveMapped(
+				engineDevice, frame.billboardBuffer, sizeof(PointLightBillboard), INITIAL_BILLBOARD_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		}
 	}
 
-	void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+	void PointLightSystem::createPipeline(EnginePipelineLibrary& pipelineLibrary, VkRenderPass renderPass, uint32_t subpass) {
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		EnginePipeline::DefaultPipelineConfigInfo(pipelineConfig);
-		EnginePipeline::EnableAlphaBlending(pipelineConfig);
-		pipelineConfig.attributeDescriptions.clear();
-		pipelineConfig.bindingDescriptions.clear();
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		enginePipeline = std::make_unique<EnginePipeline>(
-			engineDevice,
+		auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+		EnginePipeline::DefaultPipelineConfigInfo(*pipelineConfig);
+		EnginePipeline::EnableAlphaBlending(*pipelineConfig);
+		pipelineConfig->attributeDescriptions.clear();
+		pipelineConfig->bindingDescriptions.clear();
+		// Sorted and blended, so no depth writes. Also lets them draw in the deferred lighting
+		// subpass where depth is bound read-only
+		pipelineConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig->renderPass = renderPass;
+		pipelineConfig->subpass = subpass;
+		pipelineConfig->pipelineLayout = pipelineLayout;
+		enginePipeline = pipelineLibrary.GetOrCreate(
 			"shaders/point_light.vert.spv",
 			"shaders/point_light.frag.spv",
-			pipelineConfig
+			std::move(pipelineConfig)
 		);
 	}
 
-	void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
-		int lightIndex = 0;
-		auto rotateLight = glm::rotate(glm::mat4(1.f), frameInfo.frameTime, {0.0f, -1.0f, 0.0f});
+	void PointLightSystem::update(FrameInfo& frameInfo, EngineLightClusters& lightClusters) {
+		lights.clear();
 		for (auto& kv : frameInfo.gameObjects) {
 			auto& obj = kv.second;
 			if (obj.pointLight == nullptr)
 				continue;
 
-			assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
-			// obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.0f));
-
-			ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
-			ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			lightIndex++;
+			// Distance at which the inverse square falloff drops below the cutoff
+			float range = glm::sqrt(obj.pointLight->lightIntensity / LIGHT_CUTOFF_INTENSITY);
+			PointLight light{};
+			light.position = glm::vec4(obj.transform.translation, range);
+			light.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+			lights.push_back(light);
 		}
-		ubo.numLights = lightIndex;
-	
-	} 
+		lightClusters.Update(frameInfo.frameIndex, frameInfo.camera, lights);
+	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo) {
-		std::map<float, EngineGameObject::id_t> sorted;
+		// Back to front by distance to the camera, blending needs the far billboards drawn first
+		billboards.clear();
+		transparentQueue.Clear();
+		glm::vec3 cameraPosition = frameInfo.camera.GetPosition();
 		for (auto& kv : frameInfo.gameObjects) {
 			auto& obj = kv.second;
 			if (obj.pointLight == nullptr) continue;
-			// calculate distance
-			auto offset = frameInfo.camera.GetPosition() - obj.transform.translation;
-			float distSquared = glm::dot(offset, offset);
-			sorted[distSquared] = obj.GetId();
+			auto offset = cameraPosition - obj.transform.translation;
+			transparentQueue.Push(glm::dot(offset, offset), static_cast<uint32_t>(billboards.size()));
+			billboards.push_back({
+				glm::vec4(obj.transform.translation, obj.transform.scale.x),
+				glm::vec4(obj.color, obj.pointLight->lightIntensity) });
 		}
-
-
-		enginePipeline->Bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0, 1,
-			&frameInfo.globalDescriptorSet,
-			0, nullptr
-		);
-
-		// iterate through sorted lights in reverse order
-		for (auto it = sorted.rbegin(); it != sorted.rend(); it++) {
-			auto& obj = frameInfo.gameObjects.at(it->second);
-			PointLightPushConstants push{};
-			push.position = glm::vec4(obj.transform.translation, 1.0f);
-			push.color = glm::vec4(obj.color, obj.pointLight-> lightIntensity);
-			push.radius = obj.transform.scale.x;
-			vkCmdPushConstants(
-				frameInfo.commandBuffer, 
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
-				0, 
-				sizeof(PointLightPushConstants), 
-				&push);
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+		if (transparentQueue.Empty())
+			return;
+		transparentQueue.SortBackToFront();
+
+		auto& frame = frames[frameInfo.frameIndex];
+		EngineBuffer::reserveMapped(
+			engineDevice, frame.billboardBuffer, sizeof(PointLightBillboard), static_cast<uint32_t>(billboards.size()), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		auto* sorted = static_cast<PointLightBillboard*>(frame.billboardBuffer->getMappedMemory());
+		for (auto& item : transparentQueue) {
+			*sorted++ = billboards[item.payload];
 		}
-	}
+		frame.billboardBuffer->flush();
 
-	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetlayout) {
+		if (!enginePipeline.Bind(frameInfo.recorder))
+			return;
 
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(PointLightPushConstants);
+		frameInfo.recorder.BindDescriptorSets(
+			pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+		// Pushed straight into the command buffer, or built from the frame's allocator without push descriptors
+		auto bufferInfo = frame.billboardBuffer->descriptorInfo();
+		EngineDescriptorWriter(*billboardSetLayout, frameInfo.frameDescriptorAllocator)
+			.writeBuffer(0, &bufferInfo)
+			.push(frameInfo.recorder, pipelineLayout, BILLBOARD_SET);
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetlayout };
+		// Every billboard in one draw, the vertex shader reads its light by gl_InstanceIndex
+		frameInfo.recorder.Draw(6, static_cast<uint32_t>(billboards.size()), 0, 0);
+	}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data(); // Pass datas ex: Textures, uniform buffers
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange; // efficiently send small datas to shaders
-		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create pipeline layout!");
-		}
+	void PointLightSystem::createPipelineLayout(EnginePipelineLayoutCache& layoutCache) {
+		// The billboard set is pushed each frame where push descriptors are supported
+		auto& layout = layoutCache.GetLayout(
+			"shaders/point_light.vert.spv",
+			"shaders/point_light.frag.spv",
+			BILLBOARD_SET
+		);
+		assert(layout.setLayouts.size() == 2 && "Point light shaders expect the global and billboard sets");
 
+		pipelineLayout = layout.pipelineLayout;
+		billboardSetLayout = layout.setLayouts[BILLBOARD_SET];
 	}
 }
\ No newline at end of file
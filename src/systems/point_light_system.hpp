@@ -3,7 +3,14 @@
 #include "engine_game_object.hpp"
 #include "engine_device.hpp"
 #include "engine_pipeline.hpp"
+#include "engine_pipeline_library.hpp"
+#include "engine_pipeline_layout_cache.hpp"
+#include "engine_buffer.hpp"
+#include "engine_descriptors.hpp"
+#include "engine_descriptor_allocator.hpp"
+#include "engine_render_queue.hpp"
 #include "engine_frame_info.hpp"
+#include "engine_light_clusters.hpp"
 #include "engine_model.hpp"													
 #include "engine_camera.hpp"
 #include "first_app.hpp"
@@ -17,20 +24,44 @@ namespace Engine {
 
 	class PointLightSystem {
 	public:
-		PointLightSystem(EngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-		~PointLightSystem();
+		PointLightSystem(
+			EngineDevice& device,
+			EnginePipelineLibrary& pipelineLibrary,
+			EnginePipelineLayoutCache& layoutCache,
+			VkRenderPass renderPass,
+			uint32_t subpass = 0);
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-		void update(FrameInfo& frameInfo, GlobalUbo& ubo); 
+		// Gathers the scene's point lights and bins them into the frame's light clusters
+		void update(FrameInfo& frameInfo, EngineLightClusters& lightClusters);
+		// Writes the billboards sorted back to front into the frame's buffer and draws them instanced
 		void render(FrameInfo& frameInfo);
 
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetlayout);
-		void createPipeline(VkRenderPass renderPass);
+		// The billboard set is pushed every frame, no set outlives the frame
+		struct FrameResources {
+			std::unique_ptr<EngineBuffer> billboardBuffer;
+		};
+
+		// One instance of the billboard draw, matches point_light.vert
+		struct PointLightBillboard {
+			glm::vec4 position{}; // w is the billboard radius
+			glm::vec4 color{}; // w is intensity
+		};
+
+		void createPipelineLayout(EnginePipelineLayoutCache& layoutCache);
+		void createPipeline(EnginePipelineLibrary& pipelineLibrary, VkRenderPass renderPass, uint32_t subpass);
 
 		EngineDevice& engineDevice;
-		std::unique_ptr<EnginePipeline> enginePipeline;
+		EnginePipelineHandle enginePipeline;
+		std::vector<FrameResources> frames;
+		std::vector<PointLight> lights;
+		// Unsorted billboards of the frame, the queue orders them by index
+		std::vector<PointLightBillboard> billboards;
+		EngineTransparentQueue transparentQueue;
+		// Owned by the layout cache
 		VkPipelineLayout pipelineLayout;
+		EngineDescriptorSetLayout* billboardSetLayout;
 	};
 }
\ No newline at end of file
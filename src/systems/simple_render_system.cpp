@@ -11,91 +11,86 @@
 
 namespace Engine {
 
-	struct SimplePushConstantData {
-		glm::mat4 modelMatrix{ 1.0f };
-		glm::mat4 normalMatrix{ 1.0f };
-	};
-
-	SimpleRenderSystem::SimpleRenderSystem(EngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetlayout)
-		: engineDevice(device) {
-		createPipelineLayout(globalSetlayout);
-		createPipeline(renderPass);
+	SimpleRenderSystem::SimpleRenderSystem(
+		EngineDevice& device,
+		EnginePipelineLibrary& pipelineLibrary,
+		EnginePipelineLayoutCache& layoutCache,
+		VkRenderPass renderPass)
+		: engineDevice(device), pipelineLibrary(pipelineLibrary), renderPass(renderPass) {
+		createPipelineLayout(layoutCache);
+		createPipeline();
 	}
 
-	SimpleRenderSystem::~SimpleRenderSystem() {
-		vkDestroyPipelineLayout(engineDevice.device(), pipelineLayout, nullptr);
-	}
-
-	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+	void SimpleRenderSystem::createPipeline() {
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		EnginePipeline::DefaultPipelineConfigInfo(pipelineConfig);
+		enginePipeline = createVariant(true, {});
+		variantPipelines[1] = enginePipeline;
+	}
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		enginePipeline = std::make_unique<EnginePipeline>(
-			engineDevice,
+	EnginePipelineHandle SimpleRenderSystem::createVariant(bool specular, EnginePipelineHandle fallback) {
+		auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+		EnginePipeline::DefaultPipelineConfigInfo(*pipelineConfig);
+
+		pipelineConfig->renderPass = renderPass;
+		pipelineConfig->pipelineLayout = pipelineLayout;
+		EnginePipeline::SetSpecializationConstant(*pipelineConfig, SPEC_ENABLE_SPECULAR, static_cast<VkBool32>(specular));
+		EnginePipeline::SetSpecializationConstant(*pipelineConfig, SPEC_CLUSTER_X, EngineLightClusters::CLUSTER_X);
+		EnginePipeline::SetSpecializationConstant(*pipelineConfig, SPEC_CLUSTER_Y, EngineLightClusters::CLUSTER_Y);
+		EnginePipeline::SetSpecializationConstant(*pipelineConfig, SPEC_CLUSTER_Z, EngineLightClusters::CLUSTER_Z);
+		// A variant that is still compiling draws with fallback, the specular one until then
+		return pipelineLibrary.GetOrCreate(
 			"shaders/simple_shader.vert.spv",
 			"shaders/simple_shader.frag.spv",
-			pipelineConfig
+			std::move(pipelineConfig),
+			std::move(fallback)
 		);
 	}
 
-	void SimpleRenderSystem::RenderGameObjects(FrameInfo& frameInfo) {
-
-		enginePipeline->Bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0, 1,
-			&frameInfo.globalDescriptorSet,
-			0, nullptr
-		);
+	EnginePipelineHandle& SimpleRenderSystem::selectPipeline() {
+		auto& variant = variantPipelines[specularEnabled ? 1 : 0];
+		if (!variant.IsValid())
+			variant = createVariant(specularEnabled, enginePipeline);
+		return variant;
+	}
 
+	void SimpleRenderSystem::RenderGameObjects(FrameInfo& frameInfo) {
+		EnginePipeline* pipeline = selectPipeline().Get();
+		if (pipeline == nullptr)
+			return;
+
+		// Set 1 holds the clustered light lists, set 2 the object transforms
+		EngineDrawQueue::Packet packet{};
+		packet.pipeline = pipeline;
+		packet.pipelineLayout = pipelineLayout;
+		packet.descriptorSets[0] = frameInfo.globalDescriptorSet;
+		packet.dynamicSetMask = 1u << 0;
+		packet.dynamicOffsets[0] = frameInfo.globalUboOffset;
+		packet.descriptorSets[1] = frameInfo.lightDescriptorSet;
+		packet.descriptorSets[2] = frameInfo.objectDescriptorSet;
+		packet.descriptorSetCount = 3;
+
+		const glm::mat4& view = frameInfo.camera.GetView();
 		for (auto& keyVal : frameInfo.gameObjects) {
-			//obj.transform.rotation = glm::mod(obj.transform.rotation + 0.01f, glm::two_pi<float>());
 			auto& obj = keyVal.second;
 			if (obj.model == nullptr) continue;
-			for (int j = 0; j < 4; j++) {
-				SimplePushConstantData push{};
-				push.modelMatrix = obj.transform.mat4();
-				push.normalMatrix = obj.transform.normalMatrix();
-
-				vkCmdPushConstants(
-					frameInfo.commandBuffer,
-					pipelineLayout,
-					VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-					0,
-					sizeof(SimplePushConstantData),
-					&push);
-			}
-			obj.model->Bind(frameInfo.commandBuffer);
-			obj.model->Draw(frameInfo.commandBuffer);
 
+			packet.model = obj.model.get();
+			packet.firstInstance = frameInfo.objectBuffer.GetObjectIndex(obj.GetId());
+			float viewDepth = (view * glm::vec4(obj.transform.translation, 1.0f)).z;
+			frameInfo.drawQueue.Push(DRAW_PASS_OPAQUE, viewDepth, packet, nullptr);
 		}
 	}
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetlayout) {
-
-		VkPushConstantRange pushConstantRange{  };
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetlayout };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data(); // Pass datas ex: Textures, uniform buffers
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange; // efficiently send small datas to shaders
-		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create pipeline layout!");
-		}
+	void SimpleRenderSystem::createPipelineLayout(EnginePipelineLayoutCache& layoutCache) {
+		auto& layout = layoutCache.GetLayout(
+			"shaders/simple_shader.vert.spv",
+			"shaders/simple_shader.frag.spv"
+		);
+		assert(layout.setLayouts.size() == 3 && "Simple shader expects the global, light and object sets");
+		assert(layout.MatchesVertexInput(EngineModel::Vertex::GetAttributeDescriptions()) &&
+			"Model vertex attributes don't match the vertex shader inputs");
 
+		pipelineLayout = layout.pipelineLayout;
 	}
 }
\ No newline at end of file
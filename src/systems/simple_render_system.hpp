@@ -3,10 +3,14 @@
 #include "engine_game_object.hpp"
 #include "engine_device.hpp"
 #include "engine_pipeline.hpp"
+#include "engine_pipeline_library.hpp"
+#include "engine_pipeline_layout_cache.hpp"
 #include "engine_frame_info.hpp"
+#include "engine_light_clusters.hpp"
 #include "engine_model.hpp"													
 #include "engine_camera.hpp"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -16,19 +20,35 @@ namespace Engine {
 
 	class SimpleRenderSystem {
 	public:
-		SimpleRenderSystem(EngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-		~SimpleRenderSystem();
+		SimpleRenderSystem(
+			EngineDevice& device,
+			EnginePipelineLibrary& pipelineLibrary,
+			EnginePipelineLayoutCache& layoutCache,
+			VkRenderPass renderPass);
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// Queues one packet per model into frameInfo.drawQueue, recorded when the caller flushes it
 		void RenderGameObjects(FrameInfo& frameInfo);
 
+		// Switches to the pipeline variant with the specular term compiled out or back in
+		void SetSpecularEnabled(bool enabled) { specularEnabled = enabled; }
+
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetlayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelineLayout(EnginePipelineLayoutCache& layoutCache);
+		void createPipeline();
+		EnginePipelineHandle createVariant(bool specular, EnginePipelineHandle fallback);
+		EnginePipelineHandle& selectPipeline();
 
 		EngineDevice& engineDevice;
-		std::unique_ptr<EnginePipeline> enginePipeline;
+		EnginePipelineLibrary& pipelineLibrary;
+		VkRenderPass renderPass;
+		// Specular on, used while another variant is still compiling
+		EnginePipelineHandle enginePipeline;
+		// Indexed by specular, created the first frame a variant is needed
+		std::array<EnginePipelineHandle, 2> variantPipelines;
+		bool specularEnabled = true;
+		// Owned by the layout cache
 		VkPipelineLayout pipelineLayout;
 	};
 }
\ No newline at end of file
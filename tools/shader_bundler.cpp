@@ -0,0 +1,103 @@
+// Packs compiled SPIR-V files into a single bundle the engine can memory-map at startup.
+// Usage: ShaderBundler <output.spvpack> <root dir> <file.spv>...
+// Entries are named by their path relative to <root dir>, the same paths pipelines ask for.
+
+#include "engine_shader_bundle.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace Engine;
+
+static std::string relativeName(const std::string& root, std::string path) {
+	for (auto& c : path) {
+		if (c == '\\') c = '/';
+	}
+	std::string prefix = root;
+	for (auto& c : prefix) {
+		if (c == '\\') c = '/';
+	}
+	if (!prefix.empty() && prefix.back() != '/')
+		prefix += '/';
+	if (path.compare(0, prefix.size(), prefix) == 0)
+		return path.substr(prefix.size());
+	return path;
+}
+
+static uint32_t alignTo4(size_t value) {
+	return static_cast<uint32_t>((value + 3) & ~static_cast<size_t>(3));
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: ShaderBundler <output.spvpack> <root dir> <file.spv>..." << '\n';
+		return EXIT_FAILURE;
+	}
+
+	std::string outputPath = argv[1];
+	std::string root = argv[2];
+
+	std::vector<std::string> names;
+	std::vector<std::vector<char>> codes;
+	for (int i = 3; i < argc; i++) {
+		std::ifstream file{ argv[i], std::ios::binary };
+		if (!file.is_open()) {
+			std::cerr << "Failed to open file: " << argv[i] << '\n';
+			return EXIT_FAILURE;
+		}
+		codes.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		if (codes.back().size() % 4 != 0) {
+			std::cerr << "Not a SPIR-V binary: " << argv[i] << '\n';
+			return EXIT_FAILURE;
+		}
+		names.push_back(relativeName(root, argv[i]));
+	}
+
+	ShaderBundleHeader header{};
+	header.magic = SHADER_BUNDLE_MAGIC;
+	header.version = SHADER_BUNDLE_VERSION;
+	header.entryCount = static_cast<uint32_t>(names.size());
+
+	std::vector<ShaderBundleEntry> entries(names.size());
+	size_t offset = sizeof(ShaderBundleHeader) + entries.size() * sizeof(ShaderBundleEntry);
+	for (size_t i = 0; i < names.size(); i++) {
+		entries[i].nameOffset = static_cast<uint32_t>(offset);
+		entries[i].nameSize = static_cast<uint32_t>(names[i].size());
+		offset += names[i].size();
+	}
+	for (size_t i = 0; i < codes.size(); i++) {
+		offset = alignTo4(offset);
+		entries[i].codeOffset = static_cast<uint32_t>(offset);
+		entries[i].codeSize = static_cast<uint32_t>(codes[i].size());
+		offset += codes[i].size();
+	}
+
+	std::ofstream out{ outputPath, std::ios::binary | std::ios::trunc };
+	if (!out.is_open()) {
+		std::cerr << "Failed to open output: " << outputPath << '\n';
+		return EXIT_FAILURE;
+	}
+
+	size_t written = 0;
+	auto write = [&](const void* data, size_t size) {
+		out.write(static_cast<const char*>(data), size);
+		written += size;
+	};
+
+	write(&header, sizeof(header));
+	write(entries.data(), entries.size() * sizeof(ShaderBundleEntry));
+	for (auto& name : names)
+		write(name.data(), name.size());
+	for (size_t i = 0; i < codes.size(); i++) {
+		const char padding[4] = {};
+		write(padding, entries[i].codeOffset - written);
+		write(codes[i].data(), codes[i].size());
+	}
+
+	std::cout << "Bundled " << names.size() << " shaders into " << outputPath << '\n';
+	return EXIT_SUCCESS;
+}
@@ -2,5 +2,5 @@
 if not exist build mkdir build
 cd build
 cmake -S ../ -B .
-make && make Shaders && ./LearnVK
+make && ./LearnVK
 cd ../
\ No newline at end of file